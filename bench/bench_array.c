@@ -0,0 +1,29 @@
+#include "array.h"
+#include "minunit.h"
+
+#include <stdlib.h>
+
+/*
+ * ARRAY_push() growth. One push per iteration; the array is freed and starts
+ * over from empty every arg pushes, so the reallocations are included.
+ */
+
+static void array_push_bench(uint64_t iterations, long size) {
+  ARRAY(int) a = { 0 };
+  for(uint64_t i = 0; i < iterations; i++) {
+    if(a.count == size) {
+      mu_do_not_optimize(a.data[size - 1]);
+      free(a.data);
+      a.data = NULL;
+      a.count = 0;
+      a.capacity = 0;
+    }
+    ARRAY_push(&a, (int)i);
+  }
+  mu_clobber();
+  free(a.data);
+}
+
+mu_declare_bench_full(array_push_bench, 16, NULL, NULL);
+mu_declare_bench_full(array_push_bench, 4096, NULL, NULL);
+mu_declare_bench_full(array_push_bench, 1 << 20, NULL, NULL);
@@ -0,0 +1,34 @@
+#include "bin_coeff.h"
+#include "pcg.h"
+#include "minunit.h"
+
+/*
+ * Random bin_coeff() lookups over the whole supported range.
+ */
+
+#define LOOKUPS 4096
+
+static int lookups[LOOKUPS][2];
+
+static void bin_coeff_setup(long arg) {
+  (void)arg;
+  bin_coeff_init();
+  uint64_t rng = 7;
+  for(int i = 0; i < LOOKUPS; i++) {
+    lookups[i][0] = pcg_uniform(&rng, BIN_COEFF_MAX_N + 1);
+    lookups[i][1] = pcg_uniform(&rng, lookups[i][0] + 1);
+  }
+}
+
+static void bin_coeff_bench(uint64_t iterations, long arg) {
+  (void)arg;
+  int64_t acc = 0;
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    acc += bin_coeff(lookups[j][0], lookups[j][1]);
+    j = (j + 1) & (LOOKUPS - 1);
+  }
+  mu_do_not_optimize(acc);
+}
+
+mu_declare_bench_full(bin_coeff_bench, 0, bin_coeff_setup, NULL);
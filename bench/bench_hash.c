@@ -0,0 +1,419 @@
+#include "hash.h"
+#include "pcg.h"
+#include "minunit.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Chained hash tables at sizes from L1 resident (1K items) to far beyond the
+ * last level cache (4M items), with 32 bit integer keys and short string
+ * keys, both hashed with FNV1-a. Tables run at load factor 1.
+ *
+ * hash_fnv32_int and hash_fnv32_int_batch hash the shuffled keys one at a time
+ * and a block at a time, per key.
+ *
+ * hash_miss_{bloom,cuckoo}_int look up keys that are not in the table, probing
+ * the table only where a 1% filter lets them through; compare with
+ * hash_miss_int. The _batch versions query the filter HASH_BLOCK keys at a
+ * time.
+ */
+
+#define STR_KEY_LEN 16
+
+typedef struct int_node {
+  list_node_t list;
+  uint32_t key;
+  uint32_t value;
+} int_node_t;
+
+typedef struct str_node {
+  list_node_t list;
+  char key[STR_KEY_LEN];
+} str_node_t;
+
+static bool equals_int(const void *a, const void *b) {
+  return *(const uint32_t *)a == *(const uint32_t *)b;
+}
+
+static uint32_t hash_str(const void *key) {
+  uint32_t h;
+  FNV32_init(h);
+  for(const unsigned char *p = key; *p; p++) {
+    FNV32_add(h, *p);
+  }
+  return h;
+}
+
+static bool equals_str(const void *a, const void *b) {
+  return strcmp(a, b) == 0;
+}
+
+#define INT_KEY_OFFSET LIST_key_offset(int_node_t, list, key)
+#define STR_KEY_OFFSET LIST_key_offset(str_node_t, list, key)
+
+static hash_table_t table;
+static hash_bloom_t bloom;
+static hash_cuckoo_t cuckoo;
+static int_node_t *int_nodes;
+static str_node_t *str_nodes;
+// Keys in random order: hits are keys of inserted nodes, misses are not in the table.
+static uint32_t *hit_keys;
+static uint32_t *miss_keys;
+static char (*hit_strs)[STR_KEY_LEN];
+static char (*miss_strs)[STR_KEY_LEN];
+
+static void shuffle(uint32_t *v, long n, uint64_t *rng) {
+  for(long i = n - 1; i > 0; i--) {
+    long j = pcg_uniform(rng, i + 1);
+    uint32_t t = v[i];
+    v[i] = v[j];
+    v[j] = t;
+  }
+}
+
+static void make_keys(long size) {
+  uint64_t rng = 12345;
+  hit_keys = malloc(size * sizeof *hit_keys);
+  miss_keys = malloc(size * sizeof *miss_keys);
+  // Even keys are inserted, odd keys miss.
+  for(long i = 0; i < size; i++) {
+    hit_keys[i] = 2 * i;
+    miss_keys[i] = 2 * i + 1;
+  }
+  shuffle(hit_keys, size, &rng);
+  shuffle(miss_keys, size, &rng);
+}
+
+static void clear_table(void) {
+  memset(table.data, 0, table.size * sizeof(list_node_t));
+  table.count = 0;
+}
+
+static void free_table(long size) {
+  (void)size;
+  free(table.data);
+  free(int_nodes);
+  free(str_nodes);
+  free(hit_keys);
+  free(miss_keys);
+  free(hit_strs);
+  free(miss_strs);
+  table.data = NULL;
+  int_nodes = NULL;
+  str_nodes = NULL;
+  hit_keys = NULL;
+  miss_keys = NULL;
+  hit_strs = NULL;
+  miss_strs = NULL;
+}
+
+static void int_insert_all(long size) {
+  for(long i = 0; i < size; i++) {
+    int_node_t *node = &int_nodes[i];
+    HASH_insert(&table, &HASH_lookup(&table, hash_fnv32_u32, &node->key), &node->list);
+  }
+}
+
+static void int_setup_empty(long size) {
+  make_keys(size);
+  int_nodes = malloc(size * sizeof *int_nodes);
+  for(long i = 0; i < size; i++) {
+    int_nodes[i].key = 2 * i;
+    int_nodes[i].value = i;
+  }
+  HASH_init(&table, size);
+}
+
+static void int_setup(long size) {
+  int_setup_empty(size);
+  int_insert_all(size);
+}
+
+static void str_key(char *buf, uint32_t k) {
+  snprintf(buf, STR_KEY_LEN, "key:%08x", k);
+}
+
+static void str_insert_all(long size) {
+  for(long i = 0; i < size; i++) {
+    str_node_t *node = &str_nodes[i];
+    HASH_insert(&table, &HASH_lookup(&table, hash_str, node->key), &node->list);
+  }
+}
+
+static void str_setup_empty(long size) {
+  make_keys(size);
+  str_nodes = malloc(size * sizeof *str_nodes);
+  hit_strs = malloc(size * sizeof *hit_strs);
+  miss_strs = malloc(size * sizeof *miss_strs);
+  for(long i = 0; i < size; i++) {
+    str_key(str_nodes[i].key, 2 * i);
+    str_key(hit_strs[i], hit_keys[i]);
+    str_key(miss_strs[i], miss_keys[i]);
+  }
+  HASH_init(&table, size);
+}
+
+static void str_setup(long size) {
+  str_setup_empty(size);
+  str_insert_all(size);
+}
+
+/**
+ * One insert per iteration. The table is emptied after every size inserts.
+ */
+static void hash_build_int(uint64_t iterations, long size) {
+  // Start from an empty table on every call: the nodes of the previous call
+  // are still linked into it.
+  clear_table();
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    if(j == size) {
+      clear_table();
+      j = 0;
+    }
+    int_node_t *node = &int_nodes[j++];
+    HASH_insert(&table, &HASH_lookup(&table, hash_fnv32_u32, &node->key), &node->list);
+  }
+  mu_clobber();
+}
+
+static void hash_build_str(uint64_t iterations, long size) {
+  // Start from an empty table on every call: the nodes of the previous call
+  // are still linked into it.
+  clear_table();
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    if(j == size) {
+      clear_table();
+      j = 0;
+    }
+    str_node_t *node = &str_nodes[j++];
+    HASH_insert(&table, &HASH_lookup(&table, hash_str, node->key), &node->list);
+  }
+  mu_clobber();
+}
+
+static void hash_hit_int(uint64_t iterations, long size) {
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    list_node_t *head = &HASH_lookup(&table, hash_fnv32_u32, &hit_keys[j]);
+    LIST_lookup(head, equals_int, INT_KEY_OFFSET, &hit_keys[j]);
+    mu_do_not_optimize(LIST_item(head, int_node_t, list)->value);
+    if(++j == size)
+      j = 0;
+  }
+}
+
+static void hash_miss_int(uint64_t iterations, long size) {
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    list_node_t *head = &HASH_lookup(&table, hash_fnv32_u32, &miss_keys[j]);
+    LIST_lookup(head, equals_int, INT_KEY_OFFSET, &miss_keys[j]);
+    mu_do_not_optimize(*head);
+    if(++j == size)
+      j = 0;
+  }
+}
+
+static void hash_hit_str(uint64_t iterations, long size) {
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    list_node_t *head = &HASH_lookup(&table, hash_str, hit_strs[j]);
+    LIST_lookup(head, equals_str, STR_KEY_OFFSET, hit_strs[j]);
+    mu_do_not_optimize(*head);
+    if(++j == size)
+      j = 0;
+  }
+}
+
+static void hash_miss_str(uint64_t iterations, long size) {
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    list_node_t *head = &HASH_lookup(&table, hash_str, miss_strs[j]);
+    LIST_lookup(head, equals_str, STR_KEY_OFFSET, miss_strs[j]);
+    mu_do_not_optimize(*head);
+    if(++j == size)
+      j = 0;
+  }
+}
+
+/**
+ * Remove a random key and insert it again, so the table keeps its size.
+ */
+static void hash_remove_int(uint64_t iterations, long size) {
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    list_node_t *head = &HASH_lookup(&table, hash_fnv32_u32, &hit_keys[j]);
+    LIST_lookup(head, equals_int, INT_KEY_OFFSET, &hit_keys[j]);
+    int_node_t *node = LIST_item(head, int_node_t, list);
+    HASH_remove(&table, head);
+    HASH_insert(&table, &HASH_lookup(&table, hash_fnv32_u32, &node->key), &node->list);
+    if(++j == size)
+      j = 0;
+  }
+}
+
+static void hash_remove_str(uint64_t iterations, long size) {
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    list_node_t *head = &HASH_lookup(&table, hash_str, hit_strs[j]);
+    LIST_lookup(head, equals_str, STR_KEY_OFFSET, hit_strs[j]);
+    str_node_t *node = LIST_item(head, str_node_t, list);
+    HASH_remove(&table, head);
+    HASH_insert(&table, &HASH_lookup(&table, hash_str, node->key), &node->list);
+    if(++j == size)
+      j = 0;
+  }
+}
+
+/**
+ * One hash_resize() of the whole table per iteration, alternating between
+ * size and 2 * size chains.
+ */
+static void hash_resize_int(uint64_t iterations, long size) {
+  for(uint64_t i = 0; i < iterations; i++) {
+    hash_resize(&table, hash_fnv32_u32, INT_KEY_OFFSET, table.size == (size_t)size ? 2 * size : size);
+  }
+  mu_clobber();
+}
+
+static void hash_resize_str(uint64_t iterations, long size) {
+  for(uint64_t i = 0; i < iterations; i++) {
+    hash_resize(&table, hash_str, STR_KEY_OFFSET, table.size == (size_t)size ? 2 * size : size);
+  }
+  mu_clobber();
+}
+
+static void hash_fnv32_int(uint64_t iterations, long size) {
+  long j = 0;
+  uint32_t acc = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    acc ^= hash_fnv32_u32(&hit_keys[j]);
+    if(++j == size)
+      j = 0;
+  }
+  mu_do_not_optimize(acc);
+}
+
+#define HASH_BLOCK 256
+
+static void hash_fnv32_int_batch(uint64_t iterations, long size) {
+  static uint32_t hashes[HASH_BLOCK];
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i += HASH_BLOCK) {
+    size_t n = iterations - i < HASH_BLOCK ? iterations - i : HASH_BLOCK;
+    hash_fnv32_u32_batch(&hit_keys[j], n, hashes);
+    mu_clobber();
+    j += HASH_BLOCK;
+    if(j + HASH_BLOCK > size)
+      j = 0;
+  }
+}
+
+#define FILTER_FPR 0.01
+
+static void int_filter_setup(long size) {
+  int_setup(size);
+  hash_bloom_init(&bloom, hash_fnv32_u32, size, FILTER_FPR);
+  hash_bloom_insert_batch(&bloom, &int_nodes[0].key, sizeof *int_nodes, size);
+  hash_cuckoo_init(&cuckoo, hash_fnv32_u32, size, FILTER_FPR);
+  if(hash_cuckoo_insert_batch(&cuckoo, &int_nodes[0].key, sizeof *int_nodes, size) != (size_t)size)
+    panic("Cuckoo filter full");
+}
+
+static void free_filters(long size) {
+  free_table(size);
+  hash_bloom_free(&bloom);
+  hash_cuckoo_free(&cuckoo);
+}
+
+static void hash_miss_bloom_int(uint64_t iterations, long size) {
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    if(hash_bloom_contains(&bloom, &miss_keys[j])) {
+      list_node_t *head = &HASH_lookup(&table, hash_fnv32_u32, &miss_keys[j]);
+      LIST_lookup(head, equals_int, INT_KEY_OFFSET, &miss_keys[j]);
+      mu_do_not_optimize(*head);
+    }
+    if(++j == size)
+      j = 0;
+  }
+}
+
+static void hash_miss_cuckoo_int(uint64_t iterations, long size) {
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    if(hash_cuckoo_contains(&cuckoo, &miss_keys[j])) {
+      list_node_t *head = &HASH_lookup(&table, hash_fnv32_u32, &miss_keys[j]);
+      LIST_lookup(head, equals_int, INT_KEY_OFFSET, &miss_keys[j]);
+      mu_do_not_optimize(*head);
+    }
+    if(++j == size)
+      j = 0;
+  }
+}
+
+/**
+ * Probe the table for the keys of a block that passed the filter.
+ */
+static void probe_passed(const uint32_t *keys, const bool *passed, size_t n) {
+  for(size_t k = 0; k < n; k++) {
+    if(passed[k]) {
+      list_node_t *head = &HASH_lookup(&table, hash_fnv32_u32, &keys[k]);
+      LIST_lookup(head, equals_int, INT_KEY_OFFSET, &keys[k]);
+      mu_do_not_optimize(*head);
+    }
+  }
+}
+
+static void hash_miss_bloom_batch_int(uint64_t iterations, long size) {
+  bool passed[HASH_BLOCK];
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i += HASH_BLOCK) {
+    size_t n = iterations - i < HASH_BLOCK ? iterations - i : HASH_BLOCK;
+    if(hash_bloom_contains_batch(&bloom, &miss_keys[j], sizeof *miss_keys, n, passed))
+      probe_passed(&miss_keys[j], passed, n);
+    j += HASH_BLOCK;
+    if(j + HASH_BLOCK > size)
+      j = 0;
+  }
+}
+
+static void hash_miss_cuckoo_batch_int(uint64_t iterations, long size) {
+  bool passed[HASH_BLOCK];
+  long j = 0;
+  for(uint64_t i = 0; i < iterations; i += HASH_BLOCK) {
+    size_t n = iterations - i < HASH_BLOCK ? iterations - i : HASH_BLOCK;
+    if(hash_cuckoo_contains_batch(&cuckoo, &miss_keys[j], sizeof *miss_keys, n, passed))
+      probe_passed(&miss_keys[j], passed, n);
+    j += HASH_BLOCK;
+    if(j + HASH_BLOCK > size)
+      j = 0;
+  }
+}
+
+#define HASH_BENCH_T(bench, setup, teardown) \
+  mu_declare_bench_full(bench, 1L << 10, setup, teardown); \
+  mu_declare_bench_full(bench, 1L << 14, setup, teardown); \
+  mu_declare_bench_full(bench, 1L << 18, setup, teardown); \
+  mu_declare_bench_full(bench, 1L << 22, setup, teardown);
+
+#define HASH_BENCH(bench, setup) HASH_BENCH_T(bench, setup, free_table)
+
+mu_declare_bench_full(hash_fnv32_int, 1L << 14, make_keys, free_table);
+mu_declare_bench_full(hash_fnv32_int_batch, 1L << 14, make_keys, free_table);
+HASH_BENCH(hash_build_int, int_setup_empty)
+HASH_BENCH(hash_hit_int, int_setup)
+HASH_BENCH(hash_miss_int, int_setup)
+HASH_BENCH_T(hash_miss_bloom_int, int_filter_setup, free_filters)
+HASH_BENCH_T(hash_miss_bloom_batch_int, int_filter_setup, free_filters)
+HASH_BENCH_T(hash_miss_cuckoo_int, int_filter_setup, free_filters)
+HASH_BENCH_T(hash_miss_cuckoo_batch_int, int_filter_setup, free_filters)
+HASH_BENCH(hash_remove_int, int_setup)
+HASH_BENCH(hash_resize_int, int_setup)
+HASH_BENCH(hash_build_str, str_setup_empty)
+HASH_BENCH(hash_hit_str, str_setup)
+HASH_BENCH(hash_miss_str, str_setup)
+HASH_BENCH(hash_remove_str, str_setup)
+HASH_BENCH(hash_resize_str, str_setup)
@@ -0,0 +1,230 @@
+#include "lockfree.h"
+#include "minunit.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+/*
+ * Contention of the lock-free stack and queue against the same lists under a
+ * pthread mutex, with arg threads.
+ *
+ * stack: every thread pops a node from a shared free list and pushes it back,
+ * as in node recycling. One pop and push per iteration.
+ *
+ * queue: arg producers hand nodes to one consumer (the benchmark thread),
+ * which takes them in batches. The locked queue appends at a tail pointer.
+ * Each producer recycles a ring of QUEUE_RING nodes and waits while all of
+ * them are in flight. One node per iteration. The consumer checks that every
+ * node comes out exactly once and in its producer's push order.
+ *
+ * The benchmarks are declared threaded, so their threads aren't all pinned to
+ * the one CPU the harness runs on.
+ */
+
+#define STACK_NODES 1024
+#define QUEUE_RING 256
+#define MAX_THREADS 64
+
+typedef struct bench_node {
+  list_node_t list;
+  int producer;
+  // Position in the producer's sequence of pushes.
+  uint64_t seq;
+} bench_node_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static lf_stack_t lf_free;
+static list_node_t locked_free;
+static lf_queue_t lf_work;
+static list_node_t locked_work;
+static list_node_t *locked_tail;
+static bench_node_t *nodes;
+
+typedef struct bench_thread {
+  pthread_t thread;
+  uint64_t iterations;
+  int id;
+  // Nodes taken by the consumer, so the producer can reuse them.
+  uint64_t consumed;
+} bench_thread_t;
+
+static bench_thread_t threads[MAX_THREADS];
+
+static void run_threads(void *(*func)(void *), uint64_t iterations, long count) {
+  for(long i = 0; i < count; i++) {
+    threads[i].iterations = iterations / count + ((uint64_t)i < iterations % count);
+    threads[i].id = i;
+    threads[i].consumed = 0;
+    if(pthread_create(&threads[i].thread, NULL, func, &threads[i]))
+      panic("pthread_create failed");
+  }
+}
+
+static void join_threads(long count) {
+  for(long i = 0; i < count; i++) {
+    pthread_join(threads[i].thread, NULL);
+  }
+}
+
+static void stack_setup(long arg) {
+  (void)arg;
+  nodes = calloc(2 * STACK_NODES, sizeof *nodes);
+  lf_stack_init(&lf_free);
+  locked_free = NULL;
+  for(int i = 0; i < STACK_NODES; i++) {
+    lf_stack_push(&lf_free, &nodes[i].list);
+    LIST_insert(&locked_free, &nodes[STACK_NODES + i].list);
+  }
+}
+
+static void queue_setup(long count) {
+  nodes = calloc(count * QUEUE_RING, sizeof *nodes);
+  lf_queue_init(&lf_work);
+  locked_work = NULL;
+  locked_tail = &locked_work;
+}
+
+static void bench_teardown(long arg) {
+  (void)arg;
+  free(nodes);
+  nodes = NULL;
+}
+
+static void *lf_stack_thread(void *p) {
+  bench_thread_t *t = p;
+  for(uint64_t i = 0; i < t->iterations; i++) {
+    list_node_t *node = lf_stack_pop(&lf_free);
+    lf_stack_push(&lf_free, node);
+  }
+  return NULL;
+}
+
+static void *locked_stack_thread(void *p) {
+  bench_thread_t *t = p;
+  for(uint64_t i = 0; i < t->iterations; i++) {
+    pthread_mutex_lock(&lock);
+    list_node_t *node = locked_free;
+    LIST_remove(&locked_free);
+    pthread_mutex_unlock(&lock);
+
+    pthread_mutex_lock(&lock);
+    LIST_insert(&locked_free, node);
+    pthread_mutex_unlock(&lock);
+  }
+  return NULL;
+}
+
+static void lf_stack_bench(uint64_t iterations, long count) {
+  run_threads(lf_stack_thread, iterations, count);
+  join_threads(count);
+}
+
+static void locked_stack_bench(uint64_t iterations, long count) {
+  run_threads(locked_stack_thread, iterations, count);
+  join_threads(count);
+}
+
+/**
+ * Next node of the producer's ring, waiting until the consumer has taken it.
+ */
+static bench_node_t *ring_node(bench_thread_t *t, uint64_t i) {
+  while(i - __atomic_load_n(&t->consumed, __ATOMIC_ACQUIRE) >= QUEUE_RING)
+    sched_yield();
+  bench_node_t *node = &nodes[t->id * QUEUE_RING + i % QUEUE_RING];
+  node->producer = t->id;
+  node->seq = i;
+  return node;
+}
+
+static void *lf_queue_thread(void *p) {
+  bench_thread_t *t = p;
+  for(uint64_t i = 0; i < t->iterations; i++) {
+    lf_queue_push(&lf_work, &ring_node(t, i)->list);
+  }
+  return NULL;
+}
+
+static void *locked_queue_thread(void *p) {
+  bench_thread_t *t = p;
+  for(uint64_t i = 0; i < t->iterations; i++) {
+    bench_node_t *node = ring_node(t, i);
+    node->list = NULL;
+    pthread_mutex_lock(&lock);
+    // FIFO: append at the tail.
+    *locked_tail = &node->list;
+    locked_tail = &node->list;
+    pthread_mutex_unlock(&lock);
+  }
+  return NULL;
+}
+
+/**
+ * Count the nodes of a batch and hand them back to their producers. Each
+ * producer's nodes must arrive in push order, with none lost or repeated.
+ */
+static uint64_t consume(list_node_t batch) {
+  uint64_t n = 0;
+  for(list_node_t c = batch, next; c; c = next) {
+    // The producer reuses the node as soon as it is handed back.
+    next = LIST_next_direct(c);
+    bench_node_t *node = container_of(c, bench_node_t, list);
+    bench_thread_t *t = &threads[node->producer];
+    // Only the consumer writes consumed, so it is also the expected sequence.
+    if(node->seq != t->consumed)
+      panic("Producer %d: got node %" PRIu64 ", expected %" PRIu64, t->id, node->seq, t->consumed);
+    __atomic_fetch_add(&t->consumed, 1, __ATOMIC_RELEASE);
+    n++;
+  }
+  return n;
+}
+
+/**
+ * After all producers are done: every pushed node was taken.
+ */
+static void check_consumed(long count) {
+  for(long i = 0; i < count; i++) {
+    if(threads[i].consumed != threads[i].iterations)
+      panic("Producer %ld: %" PRIu64 " of %" PRIu64 " nodes consumed", i, threads[i].consumed, threads[i].iterations);
+  }
+}
+
+static void lf_queue_bench(uint64_t iterations, long count) {
+  run_threads(lf_queue_thread, iterations, count);
+  for(uint64_t n = 0; n < iterations; ) {
+    list_node_t batch = lf_queue_pop_all(&lf_work);
+    if(!batch)
+      sched_yield();
+    n += consume(batch);
+  }
+  join_threads(count);
+  check_consumed(count);
+}
+
+static void locked_queue_bench(uint64_t iterations, long count) {
+  run_threads(locked_queue_thread, iterations, count);
+  for(uint64_t n = 0; n < iterations; ) {
+    pthread_mutex_lock(&lock);
+    list_node_t batch = locked_work;
+    locked_work = NULL;
+    locked_tail = &locked_work;
+    pthread_mutex_unlock(&lock);
+    if(!batch)
+      sched_yield();
+    n += consume(batch);
+  }
+  join_threads(count);
+  check_consumed(count);
+}
+
+#define LOCKFREE_BENCH(bench, setup) \
+  mu_declare_bench_threaded(bench, 1, setup, bench_teardown); \
+  mu_declare_bench_threaded(bench, 2, setup, bench_teardown); \
+  mu_declare_bench_threaded(bench, 4, setup, bench_teardown); \
+  mu_declare_bench_threaded(bench, 8, setup, bench_teardown);
+
+LOCKFREE_BENCH(lf_stack_bench, stack_setup)
+LOCKFREE_BENCH(locked_stack_bench, stack_setup)
+LOCKFREE_BENCH(lf_queue_bench, queue_setup)
+LOCKFREE_BENCH(locked_queue_bench, queue_setup)
@@ -0,0 +1,45 @@
+#include "minunit.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * pgolib_bench: runs every benchmark declared in bench_*.c.
+ *
+ *   pgolib_bench [-f filter] [-o results.jsonl] [-b baseline.jsonl] [-t threshold]
+ *
+ * Exits with 1 if any benchmark regressed against the baseline.
+ */
+
+void panic(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+  abort();
+}
+
+int main(int argc, char **argv) {
+  const char *baseline = NULL;
+  double threshold = 0.1;
+  int opt;
+  while((opt = getopt(argc, argv, "f:o:b:t:")) != -1) {
+    switch(opt) {
+      case 'f': mu_bench_set_filter(optarg); break;
+      case 'o': mu_bench_set_output(optarg); break;
+      case 'b': baseline = optarg; break;
+      case 't': threshold = atof(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-f filter] [-o results] [-b baseline] [-t threshold]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  if(baseline)
+    mu_bench_set_baseline(baseline, threshold);
+
+  return mu_run_all_benches() ? 1 : 0;
+}
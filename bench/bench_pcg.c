@@ -0,0 +1,46 @@
+#include "pcg.h"
+#include "minunit.h"
+
+/*
+ * PCG throughput. pcg_uniform() is measured with a small bound, a large prime
+ * bound, and a bound just above 2^62 where about a third of the draws are
+ * rejected. pcg_fill() is measured per value, in blocks of PCG_BLOCK.
+ */
+
+#define PCG_BLOCK 1024
+
+static void pcg_next_bench(uint64_t iterations, long arg) {
+  (void)arg;
+  uint64_t state = 42;
+  uint32_t acc = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    acc ^= pcg_next(&state);
+  }
+  mu_do_not_optimize(acc);
+}
+
+static void pcg_uniform_bench(uint64_t iterations, long bound) {
+  uint64_t state = 42;
+  uint64_t acc = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    acc += pcg_uniform(&state, bound);
+  }
+  mu_do_not_optimize(acc);
+}
+
+static void pcg_fill_bench(uint64_t iterations, long arg) {
+  (void)arg;
+  static uint32_t buf[PCG_BLOCK];
+  uint64_t state = 42;
+  for(uint64_t i = 0; i < iterations; i += PCG_BLOCK) {
+    size_t n = iterations - i < PCG_BLOCK ? iterations - i : PCG_BLOCK;
+    pcg_fill(&state, buf, n);
+    mu_clobber();
+  }
+}
+
+mu_declare_bench(pcg_next_bench);
+mu_declare_bench(pcg_fill_bench);
+mu_declare_bench_full(pcg_uniform_bench, 6, NULL, NULL);
+mu_declare_bench_full(pcg_uniform_bench, 1000000007, NULL, NULL);
+mu_declare_bench_full(pcg_uniform_bench, (1L << 62) + 1, NULL, NULL);
@@ -0,0 +1,104 @@
+#include "rational.h"
+#include "pcg.h"
+#include "bin_coeff.h"
+#include "minunit.h"
+
+/*
+ * Tight loops over the primitives that PGOLIB_INLINE can inline. One element
+ * per iteration. bench_primitives_inline.c compiles this file again with
+ * PGOLIB_INLINE, so every benchmark is reported as name_call and
+ * name_inline and the difference is the call overhead. When pgolib itself is
+ * built with PGOLIB_INLINE, only the _inline variants exist.
+ */
+
+#ifdef PGOLIB_INLINE
+#define PRIM_MODE inline
+#else
+#define PRIM_MODE call
+#endif
+
+#define PRIM_CONCAT(name, mode) name##_##mode
+#define PRIM_NAME(name, mode) PRIM_CONCAT(name, mode)
+#define PRIM_BENCH(name) PRIM_NAME(name, PRIM_MODE)
+
+#define PRIM_COUNT 4096
+
+static rational_t a[PRIM_COUNT], b[PRIM_COUNT];
+static int nk[PRIM_COUNT][2];
+
+static void primitives_setup(long arg) {
+  (void)arg;
+  uint64_t rng = 42;
+  for(int i = 0; i < PRIM_COUNT; i++) {
+    a[i].numerator = pcg_uniform(&rng, 1000);
+    a[i].divisor = 1 + pcg_uniform(&rng, 1000);
+    b[i].numerator = pcg_uniform(&rng, 1000);
+    b[i].divisor = a[i].divisor;
+    nk[i][0] = pcg_uniform(&rng, BIN_COEFF_MAX_N + 1);
+    nk[i][1] = pcg_uniform(&rng, nk[i][0] + 1);
+  }
+  bin_coeff_init();
+}
+
+static void PRIM_BENCH(chk_mul_add)(uint64_t iterations, long arg) {
+  (void)arg;
+  rat_num_t acc = 0;
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    acc = chk_add(acc, chk_mul(a[j].numerator, b[j].numerator));
+    j = (j + 1) & (PRIM_COUNT - 1);
+  }
+  mu_do_not_optimize(acc);
+}
+
+static void PRIM_BENCH(rat_fast)(uint64_t iterations, long arg) {
+  (void)arg;
+  rat_num_t acc = 0;
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    rational_t r = a[j];
+    rat_add_fast(&r, &b[j]);
+    rat_mul_fast(&r, &b[j]);
+    acc = chk_add(acc, r.numerator);
+    j = (j + 1) & (PRIM_COUNT - 1);
+  }
+  mu_do_not_optimize(acc);
+}
+
+static void PRIM_BENCH(rat_to_d)(uint64_t iterations, long arg) {
+  (void)arg;
+  double acc = 0;
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    acc += rat_to_d(&a[j]);
+    j = (j + 1) & (PRIM_COUNT - 1);
+  }
+  mu_do_not_optimize(acc);
+}
+
+static void PRIM_BENCH(pcg_next)(uint64_t iterations, long arg) {
+  (void)arg;
+  uint64_t state = 42;
+  uint32_t acc = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    acc ^= pcg_next(&state);
+  }
+  mu_do_not_optimize(acc);
+}
+
+static void PRIM_BENCH(bin_coeff)(uint64_t iterations, long arg) {
+  (void)arg;
+  int64_t acc = 0;
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    acc += bin_coeff(nk[j][0], nk[j][1]);
+    j = (j + 1) & (PRIM_COUNT - 1);
+  }
+  mu_do_not_optimize(acc);
+}
+
+mu_declare_bench_full(PRIM_BENCH(chk_mul_add), 0, primitives_setup, NULL);
+mu_declare_bench_full(PRIM_BENCH(rat_fast), 0, primitives_setup, NULL);
+mu_declare_bench_full(PRIM_BENCH(rat_to_d), 0, primitives_setup, NULL);
+mu_declare_bench_full(PRIM_BENCH(pcg_next), 0, primitives_setup, NULL);
+mu_declare_bench_full(PRIM_BENCH(bin_coeff), 0, primitives_setup, NULL);
@@ -0,0 +1,9 @@
+/*
+ * bench_primitives.c with PGOLIB_INLINE, for the _inline variants. Empty when
+ * pgolib is built with PGOLIB_INLINE, as bench_primitives.c has them then.
+ */
+
+#ifndef PGOLIB_INLINE
+#define PGOLIB_INLINE
+#include "bench_primitives.c"
+#endif
@@ -0,0 +1,117 @@
+#include "rational.h"
+#include "rational_sort.h"
+#include "pcg.h"
+#include "minunit.h"
+
+#include <stdlib.h>
+
+/*
+ * Chains of rational operations over probabilities whose divisors all divide
+ * 720720 (= lcm(1..16)), as produced by dice and card games. The divisor of a
+ * running sum stays a divisor of 720720 while its numerator grows with the
+ * iteration count, far from overflow. Products are restarted every few steps.
+ */
+
+#define POOL 4096
+#define MUL_CHAIN 4
+
+static rational_t pool[POOL];
+static rational_t *sort_src;
+static rational_t *sort_buf;
+
+static void rational_setup(long arg) {
+  (void)arg;
+  static const int divisors[] = {
+    2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 36, 48, 52, 720, 720720
+  };
+  uint64_t rng = 99;
+  for(int i = 0; i < POOL; i++) {
+    pool[i].divisor = divisors[pcg_uniform(&rng, sizeof divisors / sizeof divisors[0])];
+    pool[i].numerator = 1 + pcg_uniform(&rng, pool[i].divisor - 1);
+    rat_normalize(&pool[i]);
+  }
+}
+
+static void rat_add_chain(uint64_t iterations, long arg) {
+  (void)arg;
+  rational_t acc = { 0, 1 };
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    rat_add(&acc, &pool[j]);
+    j = (j + 1) & (POOL - 1);
+  }
+  mu_do_not_optimize(acc.numerator);
+}
+
+static void rat_mul_chain(uint64_t iterations, long arg) {
+  (void)arg;
+  rational_t acc = { 1, 1 };
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    if(j % MUL_CHAIN == 0) {
+      mu_do_not_optimize(acc.numerator);
+      acc.numerator = 1;
+      acc.divisor = 1;
+    }
+    rat_mul(&acc, &pool[j]);
+    j = (j + 1) & (POOL - 1);
+  }
+  mu_do_not_optimize(acc.numerator);
+}
+
+static void rat_cmp_chain(uint64_t iterations, long arg) {
+  (void)arg;
+  int acc = 0;
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    acc += rat_cmp(&pool[j], &pool[(j + 1) & (POOL - 1)]);
+    j = (j + 1) & (POOL - 1);
+  }
+  mu_do_not_optimize(acc);
+}
+
+static void rat_gcd_bench(uint64_t iterations, long arg) {
+  (void)arg;
+  rat_num_t acc = 0;
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    acc += rat_gcd(pool[j].numerator * 720720, pool[(j + 1) & (POOL - 1)].divisor * 1001);
+    j = (j + 1) & (POOL - 1);
+  }
+  mu_do_not_optimize(acc);
+}
+
+static void sort_setup(long size) {
+  uint64_t rng = 5;
+  rational_setup(0);
+  sort_src = malloc(size * sizeof *sort_src);
+  sort_buf = malloc(size * sizeof *sort_buf);
+  for(long i = 0; i < size; i++) {
+    sort_src[i] = pool[pcg_uniform(&rng, POOL)];
+    rat_mul(&sort_src[i], &pool[pcg_uniform(&rng, POOL)]);
+  }
+}
+
+static void sort_teardown(long size) {
+  (void)size;
+  free(sort_src);
+  free(sort_buf);
+}
+
+/**
+ * One rat_sort() of size elements per iteration.
+ */
+static void rat_sort_bench(uint64_t iterations, long size) {
+  for(uint64_t i = 0; i < iterations; i++) {
+    for(long k = 0; k < size; k++)
+      sort_buf[k] = sort_src[k];
+    rat_sort(sort_buf, size);
+    mu_clobber();
+  }
+}
+
+mu_declare_bench_full(rat_add_chain, 0, rational_setup, NULL);
+mu_declare_bench_full(rat_mul_chain, 0, rational_setup, NULL);
+mu_declare_bench_full(rat_cmp_chain, 0, rational_setup, NULL);
+mu_declare_bench_full(rat_gcd_bench, 0, rational_setup, NULL);
+mu_declare_bench_full(rat_sort_bench, 1 << 16, sort_setup, sort_teardown);
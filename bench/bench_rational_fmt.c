@@ -0,0 +1,93 @@
+#include "rational.h"
+#include "c_ext.h"
+#include "params.h"
+#include "pcg.h"
+#include "minunit.h"
+
+/*
+ * Decimal formatting and parsing of rat_num_t. arg is the magnitude of the
+ * numbers in bits: 20 for probability numerators, 120 for wide products.
+ *
+ * rat_str_old is the conversion rat_str() did before rat_num_fmt(), one wide
+ * division per digit, kept here as the baseline.
+ */
+
+#define NUMS 1024
+
+static rat_num_t nums[NUMS];
+static char strs[NUMS][RAT_NUM_STR_SIZE];
+
+static void fmt_setup(long bits) {
+  if(bits > RAT_BITS - 2)
+    bits = RAT_BITS - 2;
+
+  uint64_t rng = 11;
+  for(int i = 0; i < NUMS; i++) {
+    rat_unum_t u = 0;
+    for(int b = 0; b < bits; b += 32)
+      u = u << 32 | pcg_next(&rng);
+    // Between 2^(bits-1) and 2^bits, so every number has about bits bits.
+    u &= ((rat_unum_t)1 << bits) - 1;
+    u |= (rat_unum_t)1 << (bits - 1);
+    nums[i] = pcg_next(&rng) & 1 ? -(rat_num_t)u : (rat_num_t)u;
+    rat_num_fmt(strs[i], nums[i]);
+  }
+}
+
+static char *rat_str_old(char *buf, rat_num_t a) {
+  rat_unum_t u = a < 0 ? -(rat_unum_t)a : (rat_unum_t)a;
+  char *p = buf + RAT_NUM_STR_SIZE - 1;
+  *p = '\0';
+  do {
+    *--p = u % 10 + '0';
+    u /= 10;
+  } while(u);
+  if(a < 0)
+    *--p = '-';
+  return p;
+}
+
+static void rat_str_old_bench(uint64_t iterations, long bits) {
+  (void)bits;
+  char buf[RAT_NUM_STR_SIZE];
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    mu_do_not_optimize(rat_str_old(buf, nums[j]));
+    mu_clobber();
+    j = (j + 1) & (NUMS - 1);
+  }
+}
+
+static void rat_num_fmt_bench(uint64_t iterations, long bits) {
+  (void)bits;
+  char buf[RAT_NUM_STR_SIZE];
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    mu_do_not_optimize(rat_num_fmt(buf, nums[j]));
+    mu_clobber();
+    j = (j + 1) & (NUMS - 1);
+  }
+}
+
+static void rat_num_parse_bench(uint64_t iterations, long bits) {
+  (void)bits;
+  rat_num_t acc = 0;
+  int j = 0;
+  for(uint64_t i = 0; i < iterations; i++) {
+    rat_num_t a;
+    if(!rat_num_parse(strs[j], &a))
+      panic("Can't parse %s", strs[j]);
+    acc += a;
+    j = (j + 1) & (NUMS - 1);
+  }
+  mu_do_not_optimize(acc);
+}
+
+#define FMT_BENCH(bench) \
+  mu_declare_bench_full(bench, 20, fmt_setup, NULL); \
+  mu_declare_bench_full(bench, 64, fmt_setup, NULL); \
+  mu_declare_bench_full(bench, 120, fmt_setup, NULL);
+
+FMT_BENCH(rat_str_old_bench)
+FMT_BENCH(rat_num_fmt_bench)
+FMT_BENCH(rat_num_parse_bench)
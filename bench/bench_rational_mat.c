@@ -0,0 +1,179 @@
+#include "rational.h"
+#include "rational_mat.h"
+#include "c_ext.h"
+#include "minunit.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Absorption problem of a lazy random walk on arg transient states: stay with
+ * probability 1/2, step left or right with probability 1/4. a = I - Q and b
+ * holds the probability of stepping into the left absorbing state.
+ *
+ * rat_mat_solve() is measured against the Gaussian elimination we used to
+ * write by hand. The determinant and inverse are taken of the integer matrix
+ * 4 (I - Q), since det(I - Q) = (n + 1) / 4^n doesn't fit for large n. One
+ * solve, determinant or inverse per iteration. The setup checks every result
+ * once.
+ */
+
+static rat_mat_t a, a4, inv;
+static rational_t *b, *x;
+
+static void random_walk(size_t n) {
+  rat_mat_init(&a, n, n);
+  rat_zero(b, n);
+  for(size_t i = 0; i < n; i++) {
+    RAT_MAT_at(&a, i, i) = (rational_t){ 1, 2 };
+    if(i > 0)
+      RAT_MAT_at(&a, i, i - 1) = (rational_t){ -1, 4 };
+    if(i + 1 < n)
+      RAT_MAT_at(&a, i, i + 1) = (rational_t){ -1, 4 };
+  }
+  b[0] = (rational_t){ 1, 4 };
+}
+
+static void solve_by_hand(const rat_mat_t *a, const rational_t *b, rational_t *x) {
+  size_t n = a->rows;
+  rational_t *m = malloc(n * n * sizeof *m);
+  memcpy(m, a->data, n * n * sizeof *m);
+  memcpy(x, b, n * sizeof *x);
+
+  for(size_t k = 0; k < n; k++) {
+    for(size_t i = k + 1; i < n; i++) {
+      if(m[i * n + k].numerator == 0)
+        continue;
+      rational_t f = m[i * n + k];
+      rat_div(&f, &m[k * n + k]);
+      for(size_t j = k; j < n; j++) {
+        rational_t t = m[k * n + j];
+        rat_mul(&t, &f);
+        rat_sub(&m[i * n + j], &t);
+      }
+      rational_t t = x[k];
+      rat_mul(&t, &f);
+      rat_sub(&x[i], &t);
+    }
+  }
+
+  for(size_t i = n; i-- > 0; ) {
+    for(size_t j = i + 1; j < n; j++) {
+      rational_t t = m[i * n + j];
+      rat_mul(&t, &x[j]);
+      rat_sub(&x[i], &t);
+    }
+    rat_div(&x[i], &m[i * n + i]);
+  }
+  free(m);
+}
+
+static void check_solution(size_t n) {
+  // Probability of leaving on the left from state i is (n - i) / (n + 1).
+  for(size_t i = 0; i < n; i++) {
+    if(x[i].numerator * (rat_num_t)(n + 1) != (rat_num_t)(n - i) * x[i].divisor)
+      panic("wrong solution at %zu", i);
+  }
+}
+
+/**
+ * a4 * inv must be the identity. a4 is tridiagonal, so only its nonzero
+ * elements are multiplied.
+ */
+static void check_inverse(size_t n) {
+  for(size_t i = 0; i < n; i++) {
+    for(size_t j = 0; j < n; j++) {
+      rational_t acc = { 0, 1 };
+      for(size_t k = 0; k < n; k++) {
+        if(RAT_MAT_at(&a4, i, k).numerator == 0)
+          continue;
+        rational_t t = RAT_MAT_at(&a4, i, k);
+        rat_mul(&t, &RAT_MAT_at(&inv, k, j));
+        rat_add(&acc, &t);
+      }
+      if(acc.numerator != (i == j) * acc.divisor)
+        panic("a * inv is not the identity at %zu, %zu", i, j);
+    }
+  }
+}
+
+static void mat_setup(long n) {
+  b = malloc(n * sizeof *b);
+  x = malloc(n * sizeof *x);
+  random_walk(n);
+
+  rat_mat_init(&a4, n, n);
+  rational_t four = { 4, 1 };
+  for(long i = 0; i < n * n; i++) {
+    a4.data[i] = a.data[i];
+    rat_mul(&a4.data[i], &four);
+  }
+  rat_mat_init(&inv, n, n);
+
+  solve_by_hand(&a, b, x);
+  check_solution(n);
+  if(!rat_mat_solve(&a, b, x))
+    panic("singular");
+  check_solution(n);
+
+  rational_t det;
+  rat_mat_det(&a4, &det);
+  if(det.numerator != (rat_num_t)(n + 1) || det.divisor != 1)
+    panic("wrong determinant");
+
+  if(!rat_mat_inverse(&a4, &inv))
+    panic("singular");
+  check_inverse(n);
+}
+
+static void mat_teardown(long n) {
+  (void)n;
+  rat_mat_free(&a);
+  rat_mat_free(&a4);
+  rat_mat_free(&inv);
+  free(b);
+  free(x);
+}
+
+static void solve_by_hand_bench(uint64_t iterations, long n) {
+  (void)n;
+  for(uint64_t i = 0; i < iterations; i++) {
+    solve_by_hand(&a, b, x);
+    mu_clobber();
+  }
+}
+
+static void rat_mat_solve_bench(uint64_t iterations, long n) {
+  (void)n;
+  for(uint64_t i = 0; i < iterations; i++) {
+    rat_mat_solve(&a, b, x);
+    mu_clobber();
+  }
+}
+
+static void rat_mat_det_bench(uint64_t iterations, long n) {
+  (void)n;
+  rational_t det;
+  for(uint64_t i = 0; i < iterations; i++) {
+    rat_mat_det(&a4, &det);
+    mu_do_not_optimize(det.numerator);
+  }
+}
+
+static void rat_mat_inverse_bench(uint64_t iterations, long n) {
+  (void)n;
+  for(uint64_t i = 0; i < iterations; i++) {
+    rat_mat_inverse(&a4, &inv);
+    mu_clobber();
+  }
+}
+
+#define MAT_BENCH(bench) \
+  mu_declare_bench_full(bench, 50, mat_setup, mat_teardown); \
+  mu_declare_bench_full(bench, 100, mat_setup, mat_teardown); \
+  mu_declare_bench_full(bench, 200, mat_setup, mat_teardown);
+
+MAT_BENCH(solve_by_hand_bench)
+MAT_BENCH(rat_mat_solve_bench)
+MAT_BENCH(rat_mat_det_bench)
+MAT_BENCH(rat_mat_inverse_bench)
@@ -0,0 +1,119 @@
+#include "rational.h"
+#include "rational_sort.h"
+#include "c_ext.h"
+#include "pcg.h"
+#include "minunit.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Sorting and selection of arg exact probabilities, many of them equal or
+ * very close: products of a few dice-like fractions. rat_sort() is measured
+ * against qsort() with the comparison rat_cmp() used to do. One sort or
+ * selection of the whole array per iteration. The setup checks every result
+ * once.
+ */
+
+#define PARTIAL_K 1000
+
+static rational_t *src;
+static rational_t *buf;
+
+/**
+ * The comparison rat_cmp() used to do: gcd, then checked cross products.
+ */
+static int qsort_cmp(const void *x, const void *y) {
+  const rational_t *a = x, *b = y;
+  rat_num_t g = rat_gcd(a->divisor, b->divisor);
+  rat_num_t an = chk_mul(a->numerator, b->divisor / g);
+  rat_num_t bn = chk_mul(b->numerator, a->divisor / g);
+  return (an > bn) - (an < bn);
+}
+
+static void check_sorted(const char *name, size_t n) {
+  for(size_t i = 1; i < n; i++) {
+    if(rat_cmp(&buf[i - 1], &buf[i]) > 0)
+      panic("%s: not sorted at %zu", name, i);
+  }
+}
+
+static void sort_setup(long size) {
+  src = malloc(size * sizeof *src);
+  buf = malloc(size * sizeof *buf);
+  uint64_t rng = 1;
+  for(long i = 0; i < size; i++) {
+    src[i].numerator = 1;
+    src[i].divisor = 1;
+    int factors = 1 + pcg_uniform(&rng, 4);
+    for(int f = 0; f < factors; f++) {
+      rational_t p;
+      p.divisor = 2 + pcg_uniform(&rng, 36);
+      p.numerator = 1 + pcg_uniform(&rng, p.divisor - 1);
+      rat_mul(&src[i], &p);
+    }
+  }
+
+  memcpy(buf, src, size * sizeof *buf);
+  qsort(buf, size, sizeof *buf, qsort_cmp);
+  check_sorted("qsort", size);
+
+  memcpy(buf, src, size * sizeof *buf);
+  rat_sort(buf, size);
+  check_sorted("rat_sort", size);
+
+  memcpy(buf, src, size * sizeof *buf);
+  rat_partial_sort(buf, size, PARTIAL_K);
+  check_sorted("rat_partial_sort", PARTIAL_K);
+
+  memcpy(buf, src, size * sizeof *buf);
+  rat_select(buf, size, size / 2);
+  for(long i = 0; i < size; i++) {
+    int c = rat_cmp(&buf[i], &buf[size / 2]);
+    if((i < size / 2 && c > 0) || (i > size / 2 && c < 0))
+      panic("rat_select: wrong side at %ld", i);
+  }
+}
+
+static void sort_teardown(long size) {
+  (void)size;
+  free(src);
+  free(buf);
+}
+
+static void qsort_gcd_bench(uint64_t iterations, long size) {
+  for(uint64_t i = 0; i < iterations; i++) {
+    memcpy(buf, src, size * sizeof *buf);
+    qsort(buf, size, sizeof *buf, qsort_cmp);
+    mu_clobber();
+  }
+}
+
+static void rat_sort_products_bench(uint64_t iterations, long size) {
+  for(uint64_t i = 0; i < iterations; i++) {
+    memcpy(buf, src, size * sizeof *buf);
+    rat_sort(buf, size);
+    mu_clobber();
+  }
+}
+
+static void rat_partial_sort_bench(uint64_t iterations, long size) {
+  for(uint64_t i = 0; i < iterations; i++) {
+    memcpy(buf, src, size * sizeof *buf);
+    rat_partial_sort(buf, size, PARTIAL_K);
+    mu_clobber();
+  }
+}
+
+static void rat_select_bench(uint64_t iterations, long size) {
+  for(uint64_t i = 0; i < iterations; i++) {
+    memcpy(buf, src, size * sizeof *buf);
+    rat_select(buf, size, size / 2);
+    mu_clobber();
+  }
+}
+
+mu_declare_bench_full(qsort_gcd_bench, 1 << 16, sort_setup, sort_teardown);
+mu_declare_bench_full(rat_sort_products_bench, 1 << 16, sort_setup, sort_teardown);
+mu_declare_bench_full(rat_partial_sort_bench, 1 << 16, sort_setup, sort_teardown);
+mu_declare_bench_full(rat_select_bench, 1 << 16, sort_setup, sort_teardown);
@@ -0,0 +1,179 @@
+#include "rational.h"
+#include "rational_vec.h"
+#include "c_ext.h"
+#include "pcg.h"
+#include "minunit.h"
+
+#include <string.h>
+
+/*
+ * The rat_vec_t kernels against the same work done with a loop of scalar
+ * rat_ operations. One pass over VEC_COUNT elements per iteration.
+ *
+ * The operands are probability-like values with divisors up to 1000. The
+ * sums run over dyadic values instead, whose lcm stays bounded, so long sums
+ * don't overflow. The setup checks once that both ways agree.
+ */
+
+#define VEC_COUNT 4096
+
+static rational_t a[VEC_COUNT], b[VEC_COUNT], dyadic[VEC_COUNT], r[VEC_COUNT];
+static rat_vec_t va, vb, vdyadic;
+
+static void check(const char *name, const rat_vec_t *v) {
+  for(size_t i = 0; i < v->count; i++) {
+    if(r[i].numerator * v->divisor[i] != v->numerator[i] * r[i].divisor)
+      panic("%s: mismatch at %zu", name, i);
+  }
+}
+
+typedef void (*scalar_op_t)(rational_t *, const rational_t *);
+typedef void (*vector_op_t)(rat_vec_t *, const rat_vec_t *);
+
+static void scalar_pass(scalar_op_t op) {
+  memcpy(r, a, sizeof r);
+  for(size_t i = 0; i < VEC_COUNT; i++)
+    op(&r[i], &b[i]);
+}
+
+static void vector_pass(vector_op_t op) {
+  rat_vec_load(&va, a);
+  op(&va, &vb);
+}
+
+static void chain_scalar_pass(void) {
+  memcpy(r, a, sizeof r);
+  for(size_t i = 0; i < VEC_COUNT; i++) {
+    rat_mul(&r[i], &b[i]);
+    rat_add(&r[i], &b[i]);
+  }
+}
+
+// Two operations, normalized once at the end.
+static void chain_vector_pass(void) {
+  rat_vec_load(&va, a);
+  rat_vec_mul_fast(&va, &vb);
+  rat_vec_add_fast(&va, &vb);
+  rat_vec_normalize(&va);
+}
+
+static void sum_scalar(rational_t *sum) {
+  sum->numerator = 0;
+  sum->divisor = 1;
+  for(size_t i = 0; i < VEC_COUNT; i++)
+    rat_add(sum, &dyadic[i]);
+}
+
+static void vec_setup(long arg) {
+  (void)arg;
+  uint64_t rng = 42;
+  for(size_t i = 0; i < VEC_COUNT; i++) {
+    a[i].divisor = 1 + pcg_uniform(&rng, 1000);
+    a[i].numerator = pcg_uniform(&rng, a[i].divisor + 1);
+  }
+  for(size_t i = 0; i < VEC_COUNT; i++) {
+    b[i].divisor = 1 + pcg_uniform(&rng, 1000);
+    b[i].numerator = pcg_uniform(&rng, b[i].divisor + 1);
+  }
+  for(size_t i = 0; i < VEC_COUNT; i++) {
+    dyadic[i].divisor = (rat_num_t)1 << pcg_uniform(&rng, 20);
+    dyadic[i].numerator = pcg_uniform(&rng, dyadic[i].divisor + 1);
+  }
+
+  rat_vec_init(&va, VEC_COUNT);
+  rat_vec_init(&vb, VEC_COUNT);
+  rat_vec_init(&vdyadic, VEC_COUNT);
+  rat_vec_load(&vb, b);
+  rat_vec_load(&vdyadic, dyadic);
+
+  scalar_pass(rat_add);
+  vector_pass(rat_vec_add);
+  check("add", &va);
+  scalar_pass(rat_sub);
+  vector_pass(rat_vec_sub);
+  check("sub", &va);
+  scalar_pass(rat_mul);
+  vector_pass(rat_vec_mul);
+  check("mul", &va);
+  scalar_pass(rat_div);
+  vector_pass(rat_vec_div);
+  check("div", &va);
+  chain_scalar_pass();
+  chain_vector_pass();
+  check("chain", &va);
+
+  rational_t sum, vsum;
+  sum_scalar(&sum);
+  rat_vec_sum(&vdyadic, &vsum);
+  if(sum.numerator * vsum.divisor != vsum.numerator * sum.divisor)
+    panic("sum: mismatch");
+}
+
+static void vec_teardown(long arg) {
+  (void)arg;
+  rat_vec_free(&va);
+  rat_vec_free(&vb);
+  rat_vec_free(&vdyadic);
+}
+
+#define VEC_BENCH(op) \
+  static void rat_##op##_loop(uint64_t iterations, long arg) { \
+    (void)arg; \
+    for(uint64_t i = 0; i < iterations; i++) { \
+      scalar_pass(rat_##op); \
+      mu_clobber(); \
+    } \
+  } \
+  static void rat_vec_##op##_bench(uint64_t iterations, long arg) { \
+    (void)arg; \
+    for(uint64_t i = 0; i < iterations; i++) { \
+      vector_pass(rat_vec_##op); \
+      mu_clobber(); \
+    } \
+  } \
+  mu_declare_bench_full(rat_##op##_loop, 0, vec_setup, vec_teardown); \
+  mu_declare_bench_full(rat_vec_##op##_bench, 0, vec_setup, vec_teardown);
+
+VEC_BENCH(add)
+VEC_BENCH(sub)
+VEC_BENCH(mul)
+VEC_BENCH(div)
+
+static void rat_mul_add_loop(uint64_t iterations, long arg) {
+  (void)arg;
+  for(uint64_t i = 0; i < iterations; i++) {
+    chain_scalar_pass();
+    mu_clobber();
+  }
+}
+
+static void rat_vec_mul_add_fast_bench(uint64_t iterations, long arg) {
+  (void)arg;
+  for(uint64_t i = 0; i < iterations; i++) {
+    chain_vector_pass();
+    mu_clobber();
+  }
+}
+
+static void rat_add_sum_loop(uint64_t iterations, long arg) {
+  (void)arg;
+  rational_t sum;
+  for(uint64_t i = 0; i < iterations; i++) {
+    sum_scalar(&sum);
+    mu_do_not_optimize(sum.numerator);
+  }
+}
+
+static void rat_vec_sum_bench(uint64_t iterations, long arg) {
+  (void)arg;
+  rational_t sum;
+  for(uint64_t i = 0; i < iterations; i++) {
+    rat_vec_sum(&vdyadic, &sum);
+    mu_do_not_optimize(sum.numerator);
+  }
+}
+
+mu_declare_bench_full(rat_mul_add_loop, 0, vec_setup, vec_teardown);
+mu_declare_bench_full(rat_vec_mul_add_fast_bench, 0, vec_setup, vec_teardown);
+mu_declare_bench_full(rat_add_sum_loop, 0, vec_setup, vec_teardown);
+mu_declare_bench_full(rat_vec_sum_bench, 0, vec_setup, vec_teardown);
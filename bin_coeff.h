@@ -1,4 +1,29 @@
+#ifndef BIN_COEFF_H
+#define BIN_COEFF_H
+
 #include <stdint.h>
 
+// See rational.h, PGOLIB_INLINE makes bin_coeff() static inline.
+#if defined(PGOLIB_INLINE) && !defined(BIN_COEFF_IMPL)
+#define BIN_COEFF_INLINE static inline
+#else
+#define BIN_COEFF_INLINE
+#endif
+
+// Largest n supported. 66 is the max for 64bit.
+#define BIN_COEFF_MAX_N 66
+
+// Pascal's triangle, compressed. Filled by bin_coeff_init(). Not part of the
+// API: it is exported only so the inline bin_coeff() links against a shared
+// pgolib too, hence the reserved-looking name.
+extern int64_t *bin_coeff_pascal_;
+
+// Fills the table on the first call, later calls do nothing.
 void bin_coeff_init(void);
-int64_t bin_coeff(int n, int k);
+BIN_COEFF_INLINE int64_t bin_coeff(int n, int k);
+
+#if defined(PGOLIB_INLINE) && !defined(BIN_COEFF_IMPL)
+#include "bin_coeff_inline.h"
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * Definition of bin_coeff(). Included by bin_coeff.h with PGOLIB_INLINE, and
+ * by bin_coeff.c for the out-of-line version.
+ */
+#ifndef BIN_COEFF_INLINE_H
+#define BIN_COEFF_INLINE_H
+
+#include <assert.h>
+
+/**
+ * Calculate the table offset.
+ */
+static inline int bin_coeff_off(int n, int k) {
+  int np = n - 3;
+  return ((np * np) / 4) + (k - 2);
+}
+
+/**
+ * Calculate the binomial coefficient of (n, k).
+ * Note that this is the same as "Combinations", aka n Choose k
+ */
+BIN_COEFF_INLINE int64_t bin_coeff(int n, int k) {
+  assert(n >= 0);
+  assert(n <= BIN_COEFF_MAX_N);
+  assert(k >= 0);
+  assert(k <= n);
+  
+  int half = n - k;
+  if(k > half) {
+    k = half;
+  }
+  
+  if(k == 0)
+    return 1;
+  
+  if(k == 1)
+    return n;
+  
+  return bin_coeff_pascal_[bin_coeff_off(n, k)];
+}
+
+#endif
@@ -6,6 +6,9 @@
 #define UNREACHABLE  __builtin_unreachable()
 #define NORETURN     __attribute__ ((noreturn))
 #define NOINLINE     __attribute__ ((noinline))
+#define ALWAYS_INLINE inline __attribute__ ((always_inline))
+#define CONSTRUCTOR  __attribute__ ((constructor))
+#define TARGET(isa)  __attribute__ ((target(isa)))
 
 #define container_of(ptr, type, member) (type *)((intptr_t)(ptr) - offsetof(type, member))
 
@@ -0,0 +1,23 @@
+#include "cpu.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+unsigned cpu_features(void) {
+  // Set by the first call, normally from a module constructor before main().
+  static int features = -1;
+  if(features >= 0)
+    return features;
+
+  features = 0;
+#ifdef CPU_X86_DISPATCH
+  const char *env = getenv("PGOLIB_CPU");
+  if(env && strcmp(env, "baseline") == 0)
+    return features;
+
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))
+    features |= CPU_AVX2;
+#endif
+  return features;
+}
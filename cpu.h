@@ -0,0 +1,30 @@
+#ifndef CPU_H
+#define CPU_H
+
+/**
+ * \brief Runtime CPU feature detection for the dispatched kernels.
+ *
+ * A module with ISA specific kernels keeps a function pointer that starts at
+ * the baseline x86-64 version and is switched by a constructor according to
+ * cpu_features(), so one binary runs everywhere and still uses AVX2 where
+ * available.
+ *
+ * Set the environment variable PGOLIB_CPU=baseline to keep the baseline
+ * kernels. Define PGOLIB_NO_DISPATCH (cmake -DPGOLIB_DISPATCH=OFF) to leave
+ * the specific kernels out of the build.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(PGOLIB_NO_DISPATCH)
+#define CPU_X86_DISPATCH
+#endif
+
+enum {
+  CPU_AVX2 = 1 << 0
+};
+
+/**
+ * Bit set of the CPU_ features of the running CPU. 0 without CPU_X86_DISPATCH.
+ */
+unsigned cpu_features(void);
+
+#endif
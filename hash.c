@@ -1,6 +1,14 @@
 #include "hash.h"
+#include "cpu.h"
+#include "pcg.h"
 
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef CPU_X86_DISPATCH
+#include <immintrin.h>
+#endif
 
 void hash_resize(hash_table_t *table_ptr, hash_func_t hash_func_ptr, long hash_key_offset, size_t newsize) { 
   list_node_t *olddata = table_ptr->data;
@@ -21,4 +29,458 @@ void hash_resize(hash_table_t *table_ptr, hash_func_t hash_func_ptr, long hash_k
   }
 
   free(olddata);
-} 
+}
+
+uint32_t hash_fnv32_u32(const void *key) {
+  uint32_t v = *(const uint32_t *)key;
+  uint32_t h;
+  FNV32_init(h);
+  for(int i = 0; i < 4; i++) {
+    FNV32_add(h, (v >> (i * 8)) & 0xff);
+  }
+  return h;
+}
+
+static void hash_fnv32_u32_batch_generic(const uint32_t *keys, size_t count, uint32_t *hashes) {
+  for(size_t i = 0; i < count; i++) {
+    hashes[i] = hash_fnv32_u32(&keys[i]);
+  }
+}
+
+#ifdef CPU_X86_DISPATCH
+TARGET("avx2") static void hash_fnv32_u32_batch_avx2(const uint32_t *keys, size_t count, uint32_t *hashes) {
+  const __m256i prime = _mm256_set1_epi32(FNV32_PRIME);
+  const __m256i byte = _mm256_set1_epi32(0xff);
+  size_t i = 0;
+  for(; i + 8 <= count; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(keys + i));
+    __m256i h = _mm256_set1_epi32((int)FNV32_OFFSET);
+    for(int j = 0; j < 4; j++) {
+      h = _mm256_xor_si256(_mm256_mullo_epi32(h, prime), _mm256_and_si256(_mm256_srli_epi32(v, j * 8), byte));
+    }
+    _mm256_storeu_si256((__m256i *)(hashes + i), h);
+  }
+  hash_fnv32_u32_batch_generic(keys + i, count - i, hashes + i);
+}
+#endif
+
+/**
+ * Murmur3 finalizer: widens the 32 bit hash_func_t result for the filters.
+ */
+static inline uint64_t hash_mix64(uint32_t h) {
+  uint64_t x = h;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+static void *hash_filter_alloc(size_t size) {
+  // Whole cache lines, cache line aligned.
+  size = (size + 63) & ~(size_t)63;
+  void *p = aligned_alloc(64, size);
+  if(!p)
+    panic("Out of memory");
+  memset(p, 0, size);
+  return p;
+}
+
+#define HASH_FILTER_RUN 32
+
+/**
+ * False positive rate of the 32 bit hash alone: a key whose hash equals that of
+ * one of capacity inserted keys always matches.
+ */
+static double hash_filter_floor(size_t capacity) {
+  return capacity / 4294967296.0;
+}
+
+/**
+ * Rate the filter structure itself must meet for a total of fpr on top of the
+ * hash floor. Targets at or below the floor are clamped to twice the floor,
+ * since most of the rate can't be bought with memory anyway.
+ */
+static double hash_filter_target(size_t capacity, double fpr) {
+  double min_fpr = hash_filter_floor(capacity);
+  return fpr - min_fpr > min_fpr ? fpr - min_fpr : min_fpr;
+}
+
+// Multipliers for the bit position in each word of a Bloom group.
+static const uint32_t hash_bloom_salt[16] = {
+  0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d, 0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31,
+  0x9e3779b1, 0x85ebca6b, 0xc2b2ae35, 0x27d4eb2f, 0x165667b1, 0xd3a2646d, 0xfd7046c5, 0xb55a4f09
+};
+
+/**
+ * False positive rate of k bit groups holding on average load keys each. The
+ * load of a group is Poisson distributed, a word with l keys has each bit set
+ * with probability 1 - (31/32)^l.
+ */
+static double hash_bloom_fpr(double load, unsigned k) {
+  double p = exp(-load);
+  double fpr = 0;
+  double end = load + 12 * sqrt(load) + 20;
+  for(int l = 0; l < end; l++) {
+    fpr += p * pow(1 - pow(31.0 / 32.0, l), k);
+    p *= load / (l + 1);
+  }
+  return fpr;
+}
+
+void hash_bloom_init(hash_bloom_t *f, hash_func_t hash, size_t capacity, double fpr) {
+  double target = hash_filter_target(capacity, fpr);
+
+  // Smallest bits per key, over all k, that meets target. Bisect on bits per key.
+  double best_bits = 0;
+  unsigned best_k = 16;
+  for(unsigned k = 1; k <= 16; k *= 2) {
+    double lo = 1, hi = 256;
+    if(hash_bloom_fpr(32.0 * k / hi, k) > target)
+      continue;
+    while(hi - lo > 0.05) {
+      double mid = (lo + hi) / 2;
+      if(hash_bloom_fpr(32.0 * k / mid, k) > target)
+        lo = mid;
+      else
+        hi = mid;
+    }
+    if(best_bits == 0 || hi < best_bits) {
+      best_bits = hi;
+      best_k = k;
+    }
+  }
+  if(best_bits == 0)
+    best_bits = 256;
+
+  size_t words = (size_t)ceil(best_bits * (capacity ? capacity : 1) / 32);
+  words = (words + 15) & ~(size_t)15;
+  f->words = hash_filter_alloc(words * sizeof(uint32_t));
+  f->groups = words / best_k;
+  f->k = best_k;
+  f->hash = hash;
+  f->fpr = hash_filter_floor(capacity) + hash_bloom_fpr((double)capacity / f->groups, best_k);
+}
+
+void hash_bloom_free(hash_bloom_t *f) {
+  free(f->words);
+  f->words = NULL;
+  f->groups = 0;
+}
+
+/**
+ * The high half of the mixed hash picks the group, the low half the bits.
+ */
+static inline uint32_t *hash_bloom_group(const hash_bloom_t *f, uint64_t x) {
+  return f->words + (((x >> 32) * f->groups) >> 32) * f->k;
+}
+
+static inline bool hash_bloom_test(const hash_bloom_t *f, uint64_t x) {
+  const uint32_t *w = hash_bloom_group(f, x);
+  uint32_t lo = (uint32_t)x;
+  uint32_t missing = 0;
+  for(unsigned j = 0; j < f->k; j++) {
+    missing |= ~w[j] & (1u << ((lo * hash_bloom_salt[j]) >> 27));
+  }
+  return !missing;
+}
+
+static size_t hash_bloom_test_run_generic(const hash_bloom_t *f, const uint64_t *x, size_t count, bool *result) {
+  size_t found = 0;
+  for(size_t i = 0; i < count; i++) {
+    result[i] = hash_bloom_test(f, x[i]);
+    found += result[i];
+  }
+  return found;
+}
+
+#ifdef CPU_X86_DISPATCH
+/**
+ * The bits of one key for 8 words of a group.
+ */
+TARGET("avx2") static inline __m256i hash_bloom_mask8(__m256i lo, const uint32_t *salt) {
+  __m256i pos = _mm256_srli_epi32(_mm256_mullo_epi32(lo, _mm256_loadu_si256((const __m256i *)salt)), 27);
+  return _mm256_sllv_epi32(_mm256_set1_epi32(1), pos);
+}
+
+TARGET("avx2") static size_t hash_bloom_test_run_avx2(const hash_bloom_t *f, const uint64_t *x, size_t count, bool *result) {
+  if(f->k != 8 && f->k != 16)
+    return hash_bloom_test_run_generic(f, x, count, result);
+
+  size_t found = 0;
+  for(size_t i = 0; i < count; i++) {
+    const __m256i *w = (const __m256i *)hash_bloom_group(f, x[i]);
+    __m256i lo = _mm256_set1_epi32((uint32_t)x[i]);
+    // testc: all mask bits set in the group.
+    int hit = _mm256_testc_si256(_mm256_load_si256(w), hash_bloom_mask8(lo, hash_bloom_salt));
+    if(f->k == 16)
+      hit &= _mm256_testc_si256(_mm256_load_si256(w + 1), hash_bloom_mask8(lo, hash_bloom_salt + 8));
+    result[i] = hit;
+    found += hit;
+  }
+  return found;
+}
+#endif
+
+static size_t (*hash_bloom_test_run_impl)(const hash_bloom_t *f, const uint64_t *x, size_t count, bool *result) = hash_bloom_test_run_generic;
+
+void hash_bloom_insert(hash_bloom_t *f, const void *key) {
+  uint64_t x = hash_mix64(f->hash(key));
+  uint32_t *w = hash_bloom_group(f, x);
+  uint32_t lo = (uint32_t)x;
+  for(unsigned j = 0; j < f->k; j++) {
+    w[j] |= 1u << ((lo * hash_bloom_salt[j]) >> 27);
+  }
+}
+
+// Also for single keys: the AVX2 test is about twice as fast.
+bool hash_bloom_contains(const hash_bloom_t *f, const void *key) {
+  uint64_t x = hash_mix64(f->hash(key));
+  bool r;
+  hash_bloom_test_run_impl(f, &x, 1, &r);
+  return r;
+}
+
+void hash_bloom_insert_batch(hash_bloom_t *f, const void *keys, size_t stride, size_t count) {
+  for(size_t i = 0; i < count; i++) {
+    hash_bloom_insert(f, (const char *)keys + i * stride);
+  }
+}
+
+size_t hash_bloom_contains_batch(const hash_bloom_t *f, const void *keys, size_t stride, size_t count, bool *result) {
+  uint64_t x[HASH_FILTER_RUN];
+  size_t found = 0;
+  for(size_t i = 0; i < count; i += HASH_FILTER_RUN) {
+    size_t n = count - i < HASH_FILTER_RUN ? count - i : HASH_FILTER_RUN;
+    for(size_t j = 0; j < n; j++) {
+      x[j] = hash_mix64(f->hash((const char *)keys + (i + j) * stride));
+      __builtin_prefetch(hash_bloom_group(f, x[j]));
+    }
+    found += hash_bloom_test_run_impl(f, x, n, result + i);
+  }
+  return found;
+}
+
+#define CUCKOO_SLOTS 4
+#define CUCKOO_MAX_KICKS 500
+
+/**
+ * A query compares against the 2 * CUCKOO_SLOTS fingerprints of two buckets.
+ */
+static double hash_cuckoo_fpr(unsigned fp_bits) {
+  return 2.0 * CUCKOO_SLOTS / (1 << fp_bits);
+}
+
+void hash_cuckoo_init(hash_cuckoo_t *f, hash_func_t hash, size_t capacity, double fpr) {
+  // The shortest fingerprint that meets the target, 16 bits if none does.
+  double target = hash_filter_target(capacity, fpr);
+  f->fp_bits = 8;
+  while(f->fp_bits < 16 && hash_cuckoo_fpr(f->fp_bits) > target)
+    f->fp_bits += 4;
+
+  size_t buckets = 1;
+  while(buckets * CUCKOO_SLOTS * 0.95 < capacity)
+    buckets *= 2;
+  f->mask = buckets - 1;
+  f->buckets = hash_filter_alloc(buckets * CUCKOO_SLOTS * f->fp_bits / 8);
+  f->fpr = hash_filter_floor(capacity) + hash_cuckoo_fpr(f->fp_bits);
+  f->count = 0;
+  f->victim = 0;
+  f->victim_index = 0;
+  f->rng = 0x853c49e6748fea9bULL;
+  f->hash = hash;
+}
+
+void hash_cuckoo_free(hash_cuckoo_t *f) {
+  free(f->buckets);
+  f->buckets = NULL;
+  f->count = 0;
+}
+
+/**
+ * 12 bit buckets are 6 bytes: the low 4 at offset 6 * i, the high 2 after them.
+ */
+static inline uint64_t hash_cuckoo_load(const hash_cuckoo_t *f, size_t i) {
+  if(f->fp_bits == 8)
+    return ((const uint32_t *)f->buckets)[i];
+  if(f->fp_bits == 16)
+    return ((const uint64_t *)f->buckets)[i];
+
+  const char *p = (const char *)f->buckets + 6 * i;
+  uint32_t lo;
+  uint16_t hi;
+  memcpy(&lo, p, sizeof lo);
+  memcpy(&hi, p + sizeof lo, sizeof hi);
+  return lo | (uint64_t)hi << 32;
+}
+
+static inline void hash_cuckoo_store(hash_cuckoo_t *f, size_t i, uint64_t b) {
+  if(f->fp_bits == 8) {
+    ((uint32_t *)f->buckets)[i] = b;
+  } else if(f->fp_bits == 16) {
+    ((uint64_t *)f->buckets)[i] = b;
+  } else {
+    char *p = (char *)f->buckets + 6 * i;
+    uint32_t lo = b;
+    uint16_t hi = b >> 32;
+    memcpy(p, &lo, sizeof lo);
+    memcpy(p + sizeof lo, &hi, sizeof hi);
+  }
+}
+
+/**
+ * Top bit of every slot of bucket b that holds fp (SWAR zero slot test), 0 if
+ * there is none. The lowest set bit is exact.
+ */
+static inline uint64_t hash_cuckoo_match(const hash_cuckoo_t *f, uint64_t b, uint32_t fp) {
+  uint64_t ones = f->fp_bits == 8 ? 0x01010101 : f->fp_bits == 12 ? 0x001001001001ULL : 0x0001000100010001ULL;
+  uint64_t v = b ^ (fp * ones);
+  return (v - ones) & ~v & (ones << (f->fp_bits - 1));
+}
+
+static inline uint32_t hash_cuckoo_fp(const hash_cuckoo_t *f, uint64_t x) {
+  uint32_t fp = (x >> 32) & ((1u << f->fp_bits) - 1);
+  // 0 marks an empty slot.
+  return fp ? fp : 1;
+}
+
+static inline size_t hash_cuckoo_alt(const hash_cuckoo_t *f, size_t i, uint32_t fp) {
+  return (i ^ (fp * 0x5bd1e995u)) & f->mask;
+}
+
+/**
+ * Put fp into an empty slot of bucket i.
+ */
+static bool hash_cuckoo_put(hash_cuckoo_t *f, size_t i, uint32_t fp) {
+  uint64_t b = hash_cuckoo_load(f, i);
+  uint64_t empty = hash_cuckoo_match(f, b, 0);
+  if(!empty)
+    return false;
+
+  int shift = __builtin_ctzll(empty) + 1 - f->fp_bits;
+  hash_cuckoo_store(f, i, b | (uint64_t)fp << shift);
+  return true;
+}
+
+/**
+ * Clear one slot of bucket i that holds fp.
+ */
+static bool hash_cuckoo_take(hash_cuckoo_t *f, size_t i, uint32_t fp) {
+  uint64_t b = hash_cuckoo_load(f, i);
+  uint64_t found = hash_cuckoo_match(f, b, fp);
+  if(!found)
+    return false;
+
+  int shift = __builtin_ctzll(found) + 1 - f->fp_bits;
+  hash_cuckoo_store(f, i, b & ~((((uint64_t)1 << f->fp_bits) - 1) << shift));
+  return true;
+}
+
+bool hash_cuckoo_insert(hash_cuckoo_t *f, const void *key) {
+  if(f->victim)
+    return false;
+
+  uint64_t x = hash_mix64(f->hash(key));
+  uint32_t fp = hash_cuckoo_fp(f, x);
+  size_t i = x & f->mask;
+  f->count++;
+  if(hash_cuckoo_put(f, i, fp) || hash_cuckoo_put(f, hash_cuckoo_alt(f, i, fp), fp))
+    return true;
+
+  // Both buckets full: evict a random fingerprint to its other bucket.
+  if(pcg_next(&f->rng) & 1)
+    i = hash_cuckoo_alt(f, i, fp);
+  for(int n = 0; n < CUCKOO_MAX_KICKS; n++) {
+    int shift = (pcg_next(&f->rng) % CUCKOO_SLOTS) * f->fp_bits;
+    uint64_t b = hash_cuckoo_load(f, i);
+    uint64_t slot = (((uint64_t)1 << f->fp_bits) - 1) << shift;
+    uint32_t evicted = (b & slot) >> shift;
+    hash_cuckoo_store(f, i, (b & ~slot) | (uint64_t)fp << shift);
+    fp = evicted;
+    i = hash_cuckoo_alt(f, i, fp);
+    if(hash_cuckoo_put(f, i, fp))
+      return true;
+  }
+
+  // Keep the homeless fingerprint, so no key is lost. The filter is full.
+  f->victim = fp;
+  f->victim_index = i;
+  return true;
+}
+
+static inline bool hash_cuckoo_test(const hash_cuckoo_t *f, uint64_t x) {
+  uint32_t fp = hash_cuckoo_fp(f, x);
+  size_t i = x & f->mask;
+  size_t j = hash_cuckoo_alt(f, i, fp);
+  if(hash_cuckoo_match(f, hash_cuckoo_load(f, i), fp) || hash_cuckoo_match(f, hash_cuckoo_load(f, j), fp))
+    return true;
+  return f->victim == fp && (f->victim_index == i || f->victim_index == j);
+}
+
+bool hash_cuckoo_contains(const hash_cuckoo_t *f, const void *key) {
+  return hash_cuckoo_test(f, hash_mix64(f->hash(key)));
+}
+
+bool hash_cuckoo_remove(hash_cuckoo_t *f, const void *key) {
+  uint64_t x = hash_mix64(f->hash(key));
+  uint32_t fp = hash_cuckoo_fp(f, x);
+  size_t i = x & f->mask;
+  size_t j = hash_cuckoo_alt(f, i, fp);
+  if(f->victim == fp && (f->victim_index == i || f->victim_index == j)) {
+    f->victim = 0;
+  } else if(!hash_cuckoo_take(f, i, fp) && !hash_cuckoo_take(f, j, fp)) {
+    return false;
+  } else if(f->victim) {
+    // A slot is free now, give it to the victim.
+    uint32_t victim = f->victim;
+    size_t v = f->victim_index;
+    if(hash_cuckoo_put(f, v, victim) || hash_cuckoo_put(f, hash_cuckoo_alt(f, v, victim), victim))
+      f->victim = 0;
+  }
+  f->count--;
+  return true;
+}
+
+size_t hash_cuckoo_insert_batch(hash_cuckoo_t *f, const void *keys, size_t stride, size_t count) {
+  for(size_t i = 0; i < count; i++) {
+    if(!hash_cuckoo_insert(f, (const char *)keys + i * stride))
+      return i;
+  }
+  return count;
+}
+
+size_t hash_cuckoo_contains_batch(const hash_cuckoo_t *f, const void *keys, size_t stride, size_t count, bool *result) {
+  uint64_t x[HASH_FILTER_RUN];
+  size_t found = 0;
+  for(size_t i = 0; i < count; i += HASH_FILTER_RUN) {
+    size_t n = count - i < HASH_FILTER_RUN ? count - i : HASH_FILTER_RUN;
+    for(size_t j = 0; j < n; j++) {
+      x[j] = hash_mix64(f->hash((const char *)keys + (i + j) * stride));
+      size_t b = x[j] & f->mask;
+      size_t bytes = f->fp_bits / 2;
+      __builtin_prefetch((const char *)f->buckets + b * bytes);
+      __builtin_prefetch((const char *)f->buckets + hash_cuckoo_alt(f, b, hash_cuckoo_fp(f, x[j])) * bytes);
+    }
+    for(size_t j = 0; j < n; j++) {
+      result[i + j] = hash_cuckoo_test(f, x[j]);
+      found += result[i + j];
+    }
+  }
+  return found;
+}
+
+static void (*hash_fnv32_u32_batch_impl)(const uint32_t *keys, size_t count, uint32_t *hashes) = hash_fnv32_u32_batch_generic;
+
+CONSTRUCTOR static void hash_dispatch_init(void) {
+#ifdef CPU_X86_DISPATCH
+  if(cpu_features() & CPU_AVX2) {
+    hash_fnv32_u32_batch_impl = hash_fnv32_u32_batch_avx2;
+    hash_bloom_test_run_impl = hash_bloom_test_run_avx2;
+  }
+#endif
+}
+
+void hash_fnv32_u32_batch(const uint32_t *keys, size_t count, uint32_t *hashes) {
+  hash_fnv32_u32_batch_impl(keys, count, hashes);
+}
@@ -180,5 +180,117 @@ struct hash_table {
   h = (h * FNV32_PRIME) ^ (v)
   
 void hash_resize(hash_table_t *table_ptr, hash_func_t hash_func_ptr, long hash_key_offset, size_t newsize);  
+
+/**
+ * FNV1-a of the 4 bytes of a uint32_t key, least significant first. Usable as
+ * a hash_func_t.
+ */
+uint32_t hash_fnv32_u32(const void *key);
+
+/**
+ * hashes[i] = hash_fnv32_u32(&keys[i]) for count keys. Dispatched to an AVX2
+ * kernel where available (see cpu.h). Only callers that hash in bulk gain from
+ * it: HASH_lookup(), hash_resize() and the filters take a hash_func_t and
+ * still hash one key at a time.
+ */
+void hash_fnv32_u32_batch(const uint32_t *keys, size_t count, uint32_t *hashes);
+
+/*
+ * Approximate membership filters, to skip the chain walk for keys that are not
+ * in a table. Both take the table's hash_func_t and widen its 32 bit result
+ * with a 64 bit mixer, so the false positive rate can't go below about
+ * count / 2^32, for a well distributed hash. A requested rate is met on top
+ * of that floor; one at or below it gets about twice the floor instead. The
+ * fpr field has the rate a filter was actually sized for.
+ *
+ * The batch functions take count keys spaced stride bytes apart. They hash a
+ * run of keys first and prefetch the filter memory for all of them, so the
+ * cache misses overlap. The query batches set result[i] and return the number
+ * of keys that may be present.
+ */
+
+/**
+ * \brief Cache line blocked Bloom filter.
+ *
+ * The bits are 32 bit words in groups of k, k a power of two dividing 16, so a
+ * group never crosses a 64 byte cache line. A key selects one group and sets
+ * one bit in each of its k words: a query is a single cache miss and a k lane
+ * SIMD test (AVX2 batch kernel, see cpu.h). k and the size are chosen for the
+ * smallest filter that meets the target false positive rate.
+ */
+typedef struct hash_bloom {
+  uint32_t *words;
+  size_t groups;
+  unsigned k;
+  hash_func_t hash;
+  // Expected false positive rate at capacity keys, hash floor included.
+  double fpr;
+} hash_bloom_t;
+
+/**
+ * \brief Allocate an empty filter.
+ *
+ * \arg capacity
+ *   Expected number of keys.
+ *
+ * \arg fpr
+ *   False positive rate at capacity keys, e.g. 0.01.
+ */
+void hash_bloom_init(hash_bloom_t *f, hash_func_t hash, size_t capacity, double fpr);
+void hash_bloom_free(hash_bloom_t *f);
+void hash_bloom_insert(hash_bloom_t *f, const void *key);
+bool hash_bloom_contains(const hash_bloom_t *f, const void *key);
+void hash_bloom_insert_batch(hash_bloom_t *f, const void *keys, size_t stride, size_t count);
+size_t hash_bloom_contains_batch(const hash_bloom_t *f, const void *keys, size_t stride, size_t count, bool *result);
+
+/**
+ * \brief Cuckoo filter with deletion.
+ *
+ * Buckets of 4 fingerprints of 8, 12 or 16 bits; a key lives in one of two
+ * buckets, the second derived from the first and the fingerprint (partial key
+ * cuckoo hashing). The false positive rate is about 8 / 2^bits, so the
+ * shortest fingerprint is picked that meets the target: 8 bits (1 byte per
+ * slot) down to 1/32, 12 bits (1.5 bytes) down to 1/512 and 16 bits (2 bytes)
+ * below that, which get no better than 8 / 2^16. 12 bit buckets are 6 bytes
+ * and can straddle a cache line. Sized for 95% load at capacity keys.
+ *
+ * Only remove keys that were inserted, or another key's fingerprint goes.
+ */
+typedef struct hash_cuckoo {
+  // uint32_t (8 bit), 6 bytes (12 bit) or uint64_t (16 bit fingerprints) per
+  // bucket.
+  void *buckets;
+  // Number of buckets - 1, a power of two.
+  size_t mask;
+  unsigned fp_bits;
+  size_t count;
+  // Fingerprint that found no slot after the last insert, 0 if none.
+  uint32_t victim;
+  size_t victim_index;
+  uint64_t rng;
+  hash_func_t hash;
+  // Expected false positive rate at capacity keys, hash floor included.
+  double fpr;
+} hash_cuckoo_t;
+
+void hash_cuckoo_init(hash_cuckoo_t *f, hash_func_t hash, size_t capacity, double fpr);
+void hash_cuckoo_free(hash_cuckoo_t *f);
+
+/**
+ * Returns false if the filter is full.
+ */
+bool hash_cuckoo_insert(hash_cuckoo_t *f, const void *key);
+bool hash_cuckoo_contains(const hash_cuckoo_t *f, const void *key);
+
+/**
+ * Returns false if no fingerprint of key was found.
+ */
+bool hash_cuckoo_remove(hash_cuckoo_t *f, const void *key);
+
+/**
+ * Stops when the filter is full. Returns the number of keys inserted.
+ */
+size_t hash_cuckoo_insert_batch(hash_cuckoo_t *f, const void *keys, size_t stride, size_t count);
+size_t hash_cuckoo_contains_batch(const hash_cuckoo_t *f, const void *keys, size_t stride, size_t count, bool *result);
   
 #endif
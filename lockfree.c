@@ -0,0 +1,143 @@
+#include "lockfree.h"
+
+#ifdef __LP64__
+typedef unsigned __int128 lf_pair_t;
+#else
+typedef uint64_t lf_pair_t;
+#endif
+
+typedef union {
+  lf_stack_t stack;
+  lf_pair_t pair;
+} lf_stack_u;
+
+// __sync on 16 bytes is only inlined as cmpxchg16b with cx16 enabled.
+#ifdef __x86_64__
+#define LF_CAS2 TARGET("cx16")
+#else
+#define LF_CAS2
+#endif
+
+/**
+ * Both words of the stack head. The two loads aren't one atomic read, a torn
+ * pair just makes the following compare and swap fail.
+ */
+static inline lf_stack_t lf_stack_load(lf_stack_t *s) {
+  lf_stack_t r;
+  r.tag = __atomic_load_n(&s->tag, __ATOMIC_ACQUIRE);
+  r.head = __atomic_load_n(&s->head, __ATOMIC_ACQUIRE);
+  return r;
+}
+
+/**
+ * Replace *s with desired if it equals *expected, otherwise load the current
+ * value into *expected.
+ */
+LF_CAS2 static inline bool lf_stack_cas(lf_stack_t *s, lf_stack_t *expected, lf_stack_t desired) {
+  lf_stack_u e = { .stack = *expected };
+  lf_stack_u d = { .stack = desired };
+  lf_stack_u r;
+  r.pair = __sync_val_compare_and_swap((lf_pair_t *)s, e.pair, d.pair);
+  if(r.pair == e.pair)
+    return true;
+  *expected = r.stack;
+  return false;
+}
+
+void lf_stack_init(lf_stack_t *s) {
+  s->head = NULL;
+  s->tag = 0;
+}
+
+LF_CAS2 void lf_stack_push_batch(lf_stack_t *s, list_node_t *first, list_node_t *last) {
+  lf_stack_t old = lf_stack_load(s);
+  lf_stack_t new;
+  do {
+    __atomic_store_n(last, old.head, __ATOMIC_RELAXED);
+    new.head = first;
+    new.tag = old.tag;
+  } while(!lf_stack_cas(s, &old, new));
+}
+
+LF_CAS2 void lf_stack_push(lf_stack_t *s, list_node_t *node) {
+  lf_stack_push_batch(s, node, node);
+}
+
+LF_CAS2 list_node_t *lf_stack_pop(lf_stack_t *s) {
+  lf_stack_t old = lf_stack_load(s);
+  lf_stack_t new;
+  do {
+    if(!old.head)
+      return NULL;
+
+    // old.head may be popped and reused meanwhile, then the tag has moved on.
+    new.head = __atomic_load_n((list_node_t *)old.head, __ATOMIC_RELAXED);
+    new.tag = old.tag + 1;
+  } while(!lf_stack_cas(s, &old, new));
+  return old.head;
+}
+
+LF_CAS2 list_node_t lf_stack_pop_all(lf_stack_t *s) {
+  lf_stack_t old = lf_stack_load(s);
+  lf_stack_t new;
+  do {
+    if(!old.head)
+      return NULL;
+
+    new.head = NULL;
+    new.tag = old.tag + 1;
+  } while(!lf_stack_cas(s, &old, new));
+  return old.head;
+}
+
+void lf_queue_init(lf_queue_t *q) {
+  q->in = NULL;
+  q->out = NULL;
+}
+
+void lf_queue_push_batch(lf_queue_t *q, list_node_t *first, list_node_t *last) {
+  list_node_t old = __atomic_load_n(&q->in, __ATOMIC_RELAXED);
+  do {
+    *last = old;
+  } while(!__atomic_compare_exchange_n(&q->in, &old, first, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+void lf_queue_push(lf_queue_t *q, list_node_t *node) {
+  lf_queue_push_batch(q, node, node);
+}
+
+/**
+ * Take the shared list and reverse it to oldest first.
+ */
+static list_node_t lf_queue_take(lf_queue_t *q) {
+  list_node_t c = __atomic_exchange_n(&q->in, NULL, __ATOMIC_ACQUIRE);
+  list_node_t r = NULL;
+  while(c) {
+    list_node_t n = LIST_next_direct(c);
+    LIST_next_direct(c) = r;
+    r = c;
+    c = n;
+  }
+  return r;
+}
+
+list_node_t *lf_queue_pop(lf_queue_t *q) {
+  if(!q->out)
+    q->out = lf_queue_take(q);
+
+  list_node_t *node = q->out;
+  if(node)
+    LIST_remove(&q->out);
+  return node;
+}
+
+list_node_t lf_queue_pop_all(lf_queue_t *q) {
+  list_node_t *tail = &q->out;
+  while(LIST_exists(tail))
+    tail = LIST_next(tail);
+  *tail = lf_queue_take(q);
+
+  list_node_t all = q->out;
+  q->out = NULL;
+  return all;
+}
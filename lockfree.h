@@ -0,0 +1,91 @@
+#ifndef LOCKFREE_H
+#define LOCKFREE_H
+
+#include "hash.h"
+
+#include <stdint.h>
+
+/*
+ * Lock-free intrusive containers on list_node_t. Nodes embed a list_node_t
+ * member exactly as for the LIST_ macros, the functions take and return
+ * pointers to that member, and container_of() gets back to the node:
+ *
+ *     my_node_t *node = container_of(lf_stack_pop(&free_nodes), my_node_t, list);
+ *
+ * Batches are ordinary lists built with LIST_insert(). A batch is passed as
+ * its first node (the list head) and its last node.
+ */
+
+/**
+ * \brief Treiber stack, safe for any number of pushing and popping threads.
+ *
+ * The head pointer is paired with a counter that every pop increments, and
+ * both are swapped with one double width compare and swap, so a node that is
+ * popped and pushed again between a pop's read and its swap (ABA) makes the
+ * swap fail instead of corrupting the stack.
+ *
+ * A pop may read the link of a node another thread has just popped, so nodes
+ * must stay readable while the stack is in use: recycle them, don't free them.
+ */
+typedef struct lf_stack {
+  list_node_t head;
+  uintptr_t tag;
+} __attribute__ ((aligned(2 * sizeof(void *)))) lf_stack_t;
+
+void lf_stack_init(lf_stack_t *s);
+void lf_stack_push(lf_stack_t *s, list_node_t *node);
+
+/**
+ * Push the list first .. last. The next pop returns first.
+ */
+void lf_stack_push_batch(lf_stack_t *s, list_node_t *first, list_node_t *last);
+
+/**
+ * Returns NULL if the stack is empty.
+ */
+list_node_t *lf_stack_pop(lf_stack_t *s);
+
+/**
+ * Take all nodes at once. Returns the head of a list in pop order.
+ */
+list_node_t lf_stack_pop_all(lf_stack_t *s);
+
+/**
+ * \brief Multi-producer single-consumer FIFO queue.
+ *
+ * Producers push onto a shared list with compare and swap. The consumer takes
+ * the whole shared list with one atomic exchange and reverses it into its
+ * private list, which it then pops without atomics. Since nodes never leave
+ * the shared list one at a time, there is no ABA problem.
+ *
+ * Nodes from one producer come out in the order they were pushed. Any number
+ * of threads may push; only one thread at a time may pop.
+ */
+typedef struct lf_queue {
+  // Shared, newest first.
+  list_node_t in;
+  // Consumer only, oldest first.
+  list_node_t out;
+} lf_queue_t;
+
+void lf_queue_init(lf_queue_t *q);
+void lf_queue_push(lf_queue_t *q, list_node_t *node);
+
+/**
+ * Push the list first .. last, built with LIST_insert(). Nodes come out in the
+ * order they were inserted into the list, so last comes out first.
+ */
+void lf_queue_push_batch(lf_queue_t *q, list_node_t *first, list_node_t *last);
+
+/**
+ * Consumer only. Returns NULL if the queue is empty.
+ */
+list_node_t *lf_queue_pop(lf_queue_t *q);
+
+/**
+ * Consumer only. Take all nodes at once. Returns the head of a list in FIFO
+ * order.
+ */
+list_node_t lf_queue_pop_all(lf_queue_t *q);
+
+#endif
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "minunit.h"
 
 #include <stdlib.h>
@@ -9,8 +10,16 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <inttypes.h>
 
-#include "minunit.h"
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "array.h"
 
 // All compilers that matter implement \e
 #define CSI_RESET  "\e[0m"
@@ -21,30 +30,330 @@
 static int tests_run;
 static int tests_ok;
 
-void mu_run_test_impl(const char *name, void (*test)()) { 
-  printf("%s\n", name);
-  
-  if(fork() == 0) {
-    test(); 
-    _exit(0);
+enum mu_status {
+  MU_RUNNING,
+  MU_OK,
+  MU_FAILED,
+  MU_TIMEOUT
+};
+
+static const char *mu_status_names[] = { "running", "ok", "failed", "timeout" };
+
+struct mu_result {
+  const char *suite;
+  const char *name;
+  pid_t pid;
+  // Captured stdout/stderr of the test while it runs, NULL when it goes
+  // straight to stdout.
+  FILE *out;
+  bool captured;
+  // Captured output of a failed test, read back when it finishes so the file
+  // doesn't stay open until the result is printed.
+  char *output;
+  size_t output_len;
+  double start;
+  double seconds;
+  enum mu_status status;
+  bool killed;
+  // Exit code, or signal number if signaled.
+  int code;
+  bool signaled;
+};
+
+static ARRAY(struct mu_result) mu_results;
+// Results before this index have been printed.
+static int mu_flushed;
+static int mu_in_flight;
+
+static bool mu_configured;
+// Set by mu_configure(), the number of online CPUs unless MU_JOBS says otherwise.
+static int mu_jobs;
+static double mu_timeout = MU_DEFAULT_TIMEOUT;
+static FILE *mu_report;
+static const char *mu_current_suite = "";
+// SIGCHLD is blocked in the calling thread while tests are in flight so
+// mu_reap() can wait for it with sigtimedwait(). Tests get the original mask
+// back, and so does the caller once mu_wait_all() has reaped everything.
+static sigset_t mu_sigchld;
+static sigset_t mu_old_sigmask;
+static bool mu_sigchld_blocked;
+
+static double mu_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void mu_configure(void);
+
+void mu_set_jobs(int jobs) {
+  if(jobs <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = cpus > 0 ? (int)cpus : 1;
   }
-  int rval;
-  wait(&rval);
-  
-  if(rval == 0) {
-    tests_ok++;
+  mu_configure();
+  mu_jobs = jobs;
+}
+
+void mu_set_timeout(double seconds) {
+  mu_configure();
+  mu_timeout = seconds;
+}
+
+void mu_set_report(const char *path) {
+  mu_configure();
+  if(mu_report)
+    fclose(mu_report);
+  mu_report = path ? fopen(path, "w") : NULL;
+  if(path && !mu_report)
+    fprintf(stderr, "minunit: can't open %s: %s\n", path, strerror(errno));
+}
+
+/**
+ * Pick up settings from the environment, once. Explicit settings override them.
+ */
+static void mu_configure(void) {
+  if(mu_configured)
+    return;
+  mu_configured = true;
+
+  const char *jobs = getenv("MU_JOBS");
+  mu_set_jobs(jobs ? atoi(jobs) : 0);
+
+  const char *timeout = getenv("MU_TIMEOUT");
+  if(timeout)
+    mu_set_timeout(atof(timeout));
+
+  const char *report = getenv("MU_REPORT");
+  if(report)
+    mu_set_report(report);
+}
+
+static void mu_write_json_str(FILE *f, const char *s) {
+  fputc('"', f);
+  for(; *s; s++) {
+    if(*s == '"' || *s == '\\')
+      fputc('\\', f);
+    if((unsigned char)*s < 0x20)
+      fprintf(f, "\\u%04x", *s);
+    else
+      fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+static void mu_print_result(struct mu_result *r) {
+  static const char *last_suite;
+
+  bool captured = r->captured;
+  if(captured) {
+    if(r->suite != last_suite)
+      printf(CSI_BOLD "%s" CSI_RESET "\n", r->suite);
+    printf("%s\n", r->name);
+  }
+  last_suite = r->suite;
+
+  if(r->status == MU_TIMEOUT) {
+    printf(CSI_BG_RED "%s: timed out after %.1fs" CSI_RESET "\n", r->name, r->seconds);
+  } else if(r->status == MU_FAILED && captured) {
+    if(r->signaled)
+      printf(CSI_BG_RED "%s: killed by signal %d" CSI_RESET "\n", r->name, r->code);
+    else
+      printf(CSI_BG_RED "%s: exit code %d" CSI_RESET "\n", r->name, r->code);
+  }
+
+  if(r->output) {
+    fwrite(r->output, 1, r->output_len, stdout);
+    free(r->output);
+  }
+
+  if(mu_report) {
+    fputs("{\"suite\":", mu_report);
+    mu_write_json_str(mu_report, r->suite);
+    fputs(",\"test\":", mu_report);
+    mu_write_json_str(mu_report, r->name);
+    fprintf(mu_report, ",\"status\":\"%s\",\"%s\":%d,\"seconds\":%.6f}\n",
+            mu_status_names[r->status], r->signaled ? "signal" : "exit", r->code, r->seconds);
+    fflush(mu_report);
+  }
+  fflush(stdout);
+}
+
+/**
+ * Print finished results in the order the tests were started, so the output
+ * doesn't depend on scheduling.
+ */
+static void mu_flush_results(void) {
+  while(mu_flushed < mu_results.count && mu_results.data[mu_flushed].status != MU_RUNNING) {
+    mu_print_result(&mu_results.data[mu_flushed]);
+    mu_flushed++;
   }
+}
+
+static void mu_finish(struct mu_result *r, int rval) {
+  r->seconds = mu_now() - r->start;
+  r->signaled = WIFSIGNALED(rval);
+  r->code = r->signaled ? WTERMSIG(rval) : WEXITSTATUS(rval);
+  if(r->killed)
+    r->status = MU_TIMEOUT;
+  else
+    r->status = rval == 0 ? MU_OK : MU_FAILED;
+
+  if(r->status == MU_OK)
+    tests_ok++;
   tests_run++;
+  mu_in_flight--;
+
+  if(r->out) {
+    // Only the output of failed tests is shown.
+    if(r->status != MU_OK) {
+      fseek(r->out, 0, SEEK_END);
+      long size = ftell(r->out);
+      r->output = size > 0 ? malloc(size) : NULL;
+      if(r->output) {
+        rewind(r->out);
+        r->output_len = fread(r->output, 1, size, r->out);
+      }
+    }
+    fclose(r->out);
+    r->out = NULL;
+  }
+}
+
+/**
+ * Wait until at least one running test has finished, killing tests that ran
+ * out of time.
+ */
+static void mu_reap(void) {
+  for(;;) {
+    bool reaped = false;
+    double t = mu_now();
+    // Earliest time a running test has to be killed.
+    double deadline = INFINITY;
+    for(int i = mu_flushed; i < mu_results.count; i++) {
+      struct mu_result *r = &mu_results.data[i];
+      if(r->status != MU_RUNNING)
+        continue;
+
+      int rval;
+      pid_t pid = waitpid(r->pid, &rval, WNOHANG);
+      if(pid == -1 && errno == ECHILD) {
+        // Someone else reaped it, the result is lost.
+        mu_finish(r, W_EXITCODE(255, 0));
+        reaped = true;
+      } else if(pid == r->pid) {
+        mu_finish(r, rval);
+        reaped = true;
+      } else if(mu_timeout > 0 && !r->killed) {
+        if(t - r->start > mu_timeout) {
+          kill(r->pid, SIGKILL);
+          r->killed = true;
+        } else if(r->start + mu_timeout < deadline) {
+          deadline = r->start + mu_timeout;
+        }
+      }
+    }
+
+    if(reaped)
+      return;
+
+    // A child that exited since the waitpid() above left SIGCHLD pending, so
+    // this returns right away rather than missing it.
+    if(deadline == INFINITY) {
+      sigwaitinfo(&mu_sigchld, NULL);
+    } else {
+      double wait = deadline - t;
+      struct timespec ts = { (time_t)wait, (long)((wait - (time_t)wait) * 1e9) };
+      sigtimedwait(&mu_sigchld, NULL, &ts);
+    }
+  }
+}
+
+static void mu_block_sigchld(void) {
+  if(mu_sigchld_blocked)
+    return;
+  mu_sigchld_blocked = true;
+  sigemptyset(&mu_sigchld);
+  sigaddset(&mu_sigchld, SIGCHLD);
+  pthread_sigmask(SIG_BLOCK, &mu_sigchld, &mu_old_sigmask);
+}
+
+void mu_wait_all(void) {
+  while(mu_in_flight > 0)
+    mu_reap();
+  mu_flush_results();
+
+  if(mu_sigchld_blocked) {
+    pthread_sigmask(SIG_SETMASK, &mu_old_sigmask, NULL);
+    mu_sigchld_blocked = false;
+  }
+}
+
+void mu_run_test_impl(const char *name, void (*test)()) {
+  mu_configure();
+  mu_block_sigchld();
+
+  struct mu_result r = { 0 };
+  r.suite = mu_current_suite;
+  r.name = name;
+  r.status = MU_RUNNING;
+
+  // In serial mode the output goes straight to stdout, as it always did.
+  if(mu_jobs > 1) {
+    r.out = tmpfile();
+    r.captured = r.out != NULL;
+  } else {
+    printf("%s\n", name);
+  }
+  fflush(stdout);
+  fflush(stderr);
+
+  r.start = mu_now();
+  r.pid = fork();
+  if(r.pid == 0) {
+    pthread_sigmask(SIG_SETMASK, &mu_old_sigmask, NULL);
+    if(r.out) {
+      dup2(fileno(r.out), STDOUT_FILENO);
+      dup2(fileno(r.out), STDERR_FILENO);
+    }
+    test();
+    fflush(stdout);
+    _exit(0);
+  }
+
+  if(r.pid == -1) {
+    fprintf(stderr, "minunit: fork failed: %s\n", strerror(errno));
+    r.status = MU_FAILED;
+    r.code = -1;
+    tests_run++;
+    if(r.out) {
+      fclose(r.out);
+      r.out = NULL;
+    }
+  } else {
+    mu_in_flight++;
+  }
+  ARRAY_push(&mu_results, r);
+
+  while(mu_in_flight >= mu_jobs)
+    mu_reap();
+  mu_flush_results();
 }
 
 void mu_run_suite_impl(const char *name, void (*suite)()) {
-  printf(CSI_BOLD "%s" CSI_RESET "\n", name); 
+  mu_configure();
+
+  // In parallel mode the suite name is printed along with its first result.
+  if(mu_jobs <= 1)
+    printf(CSI_BOLD "%s" CSI_RESET "\n", name); 
+  mu_current_suite = name;
   suite();
 }
 
 void mu_assert_impl(const char *file, int line, const char *func, bool a, const char *a_str) {
   if(!a) {
     printf("%s:%d in %s: assertion failed: %s\n", file, line, func, a_str);
+    fflush(stdout);
     abort();  
   }
 }
@@ -52,6 +361,7 @@ void mu_assert_impl(const char *file, int line, const char *func, bool a, const
 void mu_assert_eq_float_impl(const char *file, int line, const char *func, float a, float b) {
   if(nextafterf(a, b) != b) {
     printf("%s:%d in %s: %.10g != %.10g\n", file, line, func, a, b);
+    fflush(stdout);
     abort();  
   }
 }
@@ -59,6 +369,7 @@ void mu_assert_eq_float_impl(const char *file, int line, const char *func, float
 void mu_assert_eq_float_epsilon_impl(const char *file, int line, const char *func, float a, float b, float e) {
   if(fabsf(a - b) > e) {
     printf("%s:%d in %s: %.10g != %.10g\n", file, line, func, a, b);
+    fflush(stdout);
     abort();  
   }
 }
@@ -67,6 +378,7 @@ void mu_assert_eq_float_array_impl(const char *file, int line, const char *func,
   for(int i = 0; i < len; i++) {
     if(fabsf(a[i] - b[i]) > dev) {
       printf("%s:%d in %s: [%d] %.10g != %.10g\n", file, line, func, i, a[i], b[i]);
+      fflush(stdout);
       abort();
     }
   }
@@ -75,6 +387,7 @@ void mu_assert_eq_float_array_impl(const char *file, int line, const char *func,
 void mu_assert_eq_str_impl(const char *file, int line, const char *func, const char *a, const char *b) {
   if(strcmp(a, b) != 0) {
     printf("%s:%d in %s: %s != %s\n", file, line, func, a, b);
+    fflush(stdout);
     abort();  
   }
 }
@@ -86,12 +399,262 @@ void mu_register_suite_impl(struct mu_suite *s) {
   suites = s;
 }
 
-void mu_run_all_suites() {
+int mu_run_all_suites() {
   for(struct mu_suite *s = suites; s; s = s->next) {
     mu_run_suite_impl(s->name, s->func);
   }
+  mu_wait_all();
 
   printf(CSI_BOLD CSI_BG_RED "%s%d/%d Tests succeeded." CSI_RESET "\n", 
               (tests_ok < tests_run) ? CSI_BG_RED : CSI_BG_GREEN,
               tests_ok, tests_run);
+  return tests_run - tests_ok;
+}
+
+static struct mu_bench *benches;
+
+static bool mu_bench_before(const struct mu_bench *a, const struct mu_bench *b) {
+  int c = strcmp(a->file, b->file);
+  return c != 0 ? c < 0 : a->order < b->order;
+}
+
+void mu_register_bench_impl(struct mu_bench *b) {
+  // Constructors run in no particular order (reversed, under PGO), so insert
+  // sorted to keep declaration order.
+  struct mu_bench **p = &benches;
+  while(*p && mu_bench_before(*p, b))
+    p = &(*p)->next;
+  b->next = *p;
+  *p = b;
+}
+
+static bool mu_bench_configured;
+static const char *mu_bench_filter;
+static int mu_bench_samples = 15;
+static double mu_bench_min_time = 0.01;
+static int mu_bench_cpu = -1;
+static const char *mu_bench_output;
+static const char *mu_bench_baseline;
+static double mu_bench_threshold = 0.1;
+
+static void mu_bench_configure(void);
+
+void mu_bench_set_filter(const char *filter) {
+  mu_bench_configure();
+  mu_bench_filter = filter;
+}
+
+void mu_bench_set_samples(int samples) {
+  mu_bench_configure();
+  mu_bench_samples = samples > 0 ? samples : 1;
+}
+
+void mu_bench_set_min_time(double seconds) {
+  mu_bench_configure();
+  mu_bench_min_time = seconds;
+}
+
+void mu_bench_set_cpu(int cpu) {
+  mu_bench_configure();
+  mu_bench_cpu = cpu;
+}
+
+void mu_bench_set_output(const char *path) {
+  mu_bench_configure();
+  mu_bench_output = path;
+}
+
+void mu_bench_set_baseline(const char *path, double threshold) {
+  mu_bench_configure();
+  mu_bench_baseline = path;
+  mu_bench_threshold = threshold;
+}
+
+static void mu_bench_configure(void) {
+  if(mu_bench_configured)
+    return;
+  mu_bench_configured = true;
+
+  const char *v;
+  if((v = getenv("MU_BENCH_FILTER")))
+    mu_bench_set_filter(v);
+  if((v = getenv("MU_BENCH_SAMPLES")))
+    mu_bench_set_samples(atoi(v));
+  if((v = getenv("MU_BENCH_MIN_TIME")))
+    mu_bench_set_min_time(atof(v));
+  if((v = getenv("MU_BENCH_CPU")))
+    mu_bench_set_cpu(atoi(v));
+  if((v = getenv("MU_BENCH_OUTPUT")))
+    mu_bench_set_output(v);
+  if((v = getenv("MU_BENCH_THRESHOLD")))
+    mu_bench_threshold = atof(v);
+  if((v = getenv("MU_BENCH_BASELINE")))
+    mu_bench_set_baseline(v, mu_bench_threshold);
+}
+
+struct mu_bench_result {
+  char name[128];
+  double median;
+  double mad;
+  double min;
+  uint64_t iterations;
+};
+
+static int mu_cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double mu_median(double *v, int n) {
+  qsort(v, n, sizeof *v, mu_cmp_double);
+  return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static double mu_bench_time(const struct mu_bench *b, uint64_t iterations) {
+  double t = mu_now();
+  b->func(iterations, b->arg);
+  return mu_now() - t;
+}
+
+static void mu_bench_run(const struct mu_bench *b, struct mu_bench_result *r) {
+  if(b->setup)
+    b->setup(b->arg);
+
+  // Calibrate: grow the iteration count until a sample is long enough. This
+  // also warms up caches and branch predictors. The first pass can stop early
+  // on cold effects such as page faults, so calibrate once more when warm.
+  uint64_t n = 1;
+  for(int pass = 0; pass < 2; pass++) {
+    for(;;) {
+      double t = mu_bench_time(b, n);
+      if(t >= mu_bench_min_time || n >= (UINT64_C(1) << 40))
+        break;
+
+      double scale = t > 0 ? mu_bench_min_time / t * 1.2 : 100;
+      n = scale < 2 ? n * 2 : scale > 100 ? n * 100 : (uint64_t)(n * scale);
+    }
+  }
+
+  double *samples = malloc(mu_bench_samples * sizeof *samples);
+  for(int i = 0; i < mu_bench_samples; i++) {
+    samples[i] = mu_bench_time(b, n) * 1e9 / n;
+  }
+
+  r->iterations = n;
+  r->median = mu_median(samples, mu_bench_samples);
+  r->min = samples[0];
+  for(int i = 0; i < mu_bench_samples; i++) {
+    samples[i] = fabs(samples[i] - r->median);
+  }
+  r->mad = mu_median(samples, mu_bench_samples);
+  free(samples);
+
+  if(b->teardown)
+    b->teardown(b->arg);
+}
+
+/**
+ * Look up a benchmark's median in a results file.
+ */
+static bool mu_bench_lookup(FILE *f, const char *name, double *median) {
+  char line[512];
+  char found[128];
+  rewind(f);
+  while(fgets(line, sizeof line, f)) {
+    if(sscanf(line, "{\"bench\":\"%127[^\"]\",\"median_ns\":%lf", found, median) == 2 &&
+       strcmp(found, name) == 0)
+      return true;
+  }
+  return false;
+}
+
+#ifdef __linux__
+static bool mu_bench_pin(cpu_set_t *old) {
+  int cpu = mu_bench_cpu >= 0 ? mu_bench_cpu : sched_getcpu();
+  if(cpu < 0 || sched_getaffinity(0, sizeof *old, old) != 0)
+    return false;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if(sched_setaffinity(0, sizeof set, &set) != 0) {
+    fprintf(stderr, "minunit: can't pin to CPU %d: %s\n", cpu, strerror(errno));
+    return false;
+  }
+  return true;
+}
+#endif
+
+int mu_run_all_benches() {
+  mu_bench_configure();
+
+#ifdef __linux__
+  cpu_set_t old_affinity, pinned_affinity;
+  bool pinned = mu_bench_pin(&old_affinity);
+  if(pinned)
+    sched_getaffinity(0, sizeof pinned_affinity, &pinned_affinity);
+#endif
+
+  FILE *out = NULL;
+  if(mu_bench_output && !(out = fopen(mu_bench_output, "w")))
+    fprintf(stderr, "minunit: can't open %s: %s\n", mu_bench_output, strerror(errno));
+
+  FILE *baseline = NULL;
+  if(mu_bench_baseline && !(baseline = fopen(mu_bench_baseline, "r")))
+    fprintf(stderr, "minunit: can't open %s: %s\n", mu_bench_baseline, strerror(errno));
+
+  int regressions = 0;
+  printf(CSI_BOLD "%-40s %12s %10s %12s %14s" CSI_RESET "\n", "benchmark", "median ns", "mad", "min ns", "iterations");
+  for(struct mu_bench *b = benches; b; b = b->next) {
+    struct mu_bench_result r;
+    if(b->arg)
+      snprintf(r.name, sizeof r.name, "%s/%ld", b->name, b->arg);
+    else
+      snprintf(r.name, sizeof r.name, "%s", b->name);
+
+    if(mu_bench_filter && !strstr(r.name, mu_bench_filter))
+      continue;
+
+#ifdef __linux__
+    // Threads inherit the pinning; let them spread out again.
+    if(pinned && b->threaded)
+      sched_setaffinity(0, sizeof old_affinity, &old_affinity);
+#endif
+    mu_bench_run(b, &r);
+#ifdef __linux__
+    if(pinned && b->threaded)
+      sched_setaffinity(0, sizeof pinned_affinity, &pinned_affinity);
+#endif
+    printf("%-40s %12.3f %10.3f %12.3f %14" PRIu64, r.name, r.median, r.mad, r.min, r.iterations);
+
+    double base;
+    if(baseline && mu_bench_lookup(baseline, r.name, &base) && base > 0) {
+      double change = r.median / base - 1;
+      bool regressed = change > mu_bench_threshold;
+      printf("  %s%+6.1f%%%s", regressed ? CSI_BG_RED : "", change * 100, regressed ? CSI_RESET : "");
+      regressions += regressed;
+    }
+    printf("\n");
+    fflush(stdout);
+
+    if(out) {
+      fprintf(out, "{\"bench\":\"%s\",\"median_ns\":%.4f,\"mad_ns\":%.4f,\"min_ns\":%.4f,\"iterations\":%" PRIu64 ",\"samples\":%d}\n",
+              r.name, r.median, r.mad, r.min, r.iterations, mu_bench_samples);
+    }
+  }
+
+  if(out)
+    fclose(out);
+  if(baseline) {
+    fclose(baseline);
+    printf("%s%d regression(s) beyond %.0f%%" CSI_RESET "\n",
+           regressions ? CSI_BOLD CSI_BG_RED : CSI_BOLD CSI_BG_GREEN, regressions, mu_bench_threshold * 100);
+  }
+
+#ifdef __linux__
+  if(pinned)
+    sched_setaffinity(0, sizeof old_affinity, &old_affinity);
+#endif
+
+  return regressions;
 }
@@ -3,6 +3,8 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include "params.h"
 
@@ -25,8 +27,16 @@
  * mu_declare_suite(my_test_suite);
  * ~~~
  * 
+ * Every test runs in its own process, by default as many at once as there are
+ * online CPUs. mu_set_jobs() (or the MU_JOBS environment variable) changes
+ * that; 1 runs them one at a time. Every test is killed when it exceeds the
+ * timeout set with mu_set_timeout() (or MU_TIMEOUT, in seconds). mu_set_report() (or MU_REPORT) additionally writes
+ * one JSON object per test to a file.
  */
 
+//! Default wall-clock limit per test, in seconds.
+#define MU_DEFAULT_TIMEOUT 60
+
 /*!
  * \brief Run a test. 
  * 
@@ -57,6 +67,89 @@ static void mu_declare_##suite() { \
   mu_register_suite_impl(&s); \
 }
 
+/*!
+ * \brief A micro-benchmark.
+ *
+ * func must do the work under test iterations times. setup and teardown, if
+ * not NULL, run before and after all measurements of the benchmark and are
+ * not timed. arg is passed to all three, so one function can be declared for
+ * several problem sizes.
+ */
+struct mu_bench {
+  const char *name;
+  void (*func)(uint64_t iterations, long arg);
+  void (*setup)(long arg);
+  void (*teardown)(long arg);
+  long arg;
+  // Runs its own threads, so it isn't pinned to one CPU.
+  bool threaded;
+  // Where it was declared; benchmarks run sorted by file, then declaration.
+  const char *file;
+  int order;
+  struct mu_bench *next;
+};
+
+#define MU_CONCAT_(a, b) a##b
+#define MU_CONCAT(a, b)  MU_CONCAT_(a, b)
+
+/*!
+ * \brief Declare a benchmark for mu_run_all_benches(), with an argument and
+ * untimed setup and teardown.
+ *
+ * ~~~
+ * static void bench_sum(uint64_t iterations, long size) {
+ *   for(uint64_t i = 0; i < iterations; i++)
+ *     mu_do_not_optimize(sum(array, size));
+ * }
+ *
+ * mu_declare_bench_full(bench_sum, 1024, make_array, free_array);
+ * mu_declare_bench_full(bench_sum, 1 << 20, make_array, free_array);
+ * ~~~
+ *
+ * A benchmark declared with arg != 0 is reported as "name/arg". Benchmarks
+ * run in the order they are declared in a file, and files in order of their
+ * names; constructors alone don't fix an order.
+ */
+#define mu_declare_bench_full(bench, bench_arg, bench_setup, bench_teardown) \
+  MU_DECLARE_BENCH(bench, bench_arg, bench_setup, bench_teardown, false)
+
+/*!
+ * \brief Declare a benchmark that starts threads of its own.
+ *
+ * Like mu_declare_bench_full(), but the benchmark runs with the affinity the
+ * process had before mu_run_all_benches() pinned it, since threads inherit
+ * the pinning and would otherwise all share one CPU.
+ */
+#define mu_declare_bench_threaded(bench, bench_arg, bench_setup, bench_teardown) \
+  MU_DECLARE_BENCH(bench, bench_arg, bench_setup, bench_teardown, true)
+
+#define MU_DECLARE_BENCH(bench, bench_arg, bench_setup, bench_teardown, bench_threaded) \
+__attribute__((constructor))  \
+static void MU_CONCAT(mu_declare_##bench##_, __COUNTER__)() { \
+  static struct mu_bench b; \
+  b.name = #bench; \
+  b.func = bench; \
+  b.setup = bench_setup; \
+  b.teardown = bench_teardown; \
+  b.arg = bench_arg; \
+  b.threaded = bench_threaded; \
+  b.file = __FILE__; \
+  b.order = __COUNTER__; \
+  mu_register_bench_impl(&b); \
+}
+
+//! Declare a benchmark without argument, setup or teardown.
+#define mu_declare_bench(bench) mu_declare_bench_full(bench, 0, NULL, NULL)
+
+/*!
+ * \brief Make the compiler assume value is used, so the work producing it can't
+ * be deleted.
+ */
+#define mu_do_not_optimize(value) __asm__ volatile("" : : "r,m"(value) : "memory")
+
+//! Make the compiler assume all memory was read and written.
+#define mu_clobber() __asm__ volatile("" : : : "memory")
+
 //! Check an expression for truth.
 #define mu_assert(a)             mu_assert_impl(__FILE__, __LINE__, __func__, (a), #a)
 #define mu_assert_eq_str(a, b)   mu_assert_eq_str_impl(__FILE__, __LINE__, __func__, a, b)
@@ -76,8 +169,36 @@ static void mu_declare_##suite() { \
 
 EXTERN_C_BEGIN
 
-//! Run all test suites previously registered or declared.
-void mu_run_all_suites(void);
+//! Run all test suites previously registered or declared. Returns the number of failed tests.
+int mu_run_all_suites(void);
+
+/*!
+ * \brief Run up to jobs tests at the same time.
+ *
+ * The output of each test is captured and only shown if it fails. Results are
+ * printed in the order the tests were started, so the output is the same
+ * regardless of scheduling.
+ *
+ * \param jobs Number of tests in flight. 0 (the default) uses the number of
+ *   online CPUs, 1 runs tests one at a time with their output going straight
+ *   to stdout.
+ */
+void mu_set_jobs(int jobs);
+
+//! Kill tests that run longer than seconds of wall-clock time. 0 disables the limit.
+void mu_set_timeout(double seconds);
+
+//! Write one JSON object per finished test to path, in start order. NULL stops reporting.
+void mu_set_report(const char *path);
+
+/*!
+ * \brief Wait for all running tests and print their results.
+ *
+ * mu_run_all_suites() does this before printing the totals. Only needed when
+ * running suites by hand in parallel mode. Running a test blocks SIGCHLD in
+ * the calling thread; this restores the previous signal mask.
+ */
+void mu_wait_all(void);
 
 void mu_run_test_impl(const char *name, void (*test)());
 void mu_run_suite_impl(const char *name, void (*suite)());
@@ -88,6 +209,49 @@ void mu_assert_eq_float_epsilon_impl(const char *file, int line, const char *fun
 void mu_assert_eq_float_array_impl(const char *file, int line, const char *func, float a[], float b[], int len, float dev);
 void mu_assert_eq_str_impl(const char *file, int line, const char *func, const char *a, const char *b);
 
+/*!
+ * \brief Run all declared benchmarks.
+ *
+ * Each benchmark is warmed up, its iteration count is raised until one sample
+ * takes at least the minimum sample time, and then a number of samples are
+ * taken. Reported are the median, the median absolute deviation and the
+ * minimum, in ns per iteration, from the monotonic clock. On Linux the process
+ * is pinned to one CPU for the duration, except while running benchmarks
+ * declared with mu_declare_bench_threaded().
+ *
+ * Settings can also come from the environment: MU_BENCH_FILTER,
+ * MU_BENCH_SAMPLES, MU_BENCH_MIN_TIME, MU_BENCH_CPU, MU_BENCH_OUTPUT,
+ * MU_BENCH_BASELINE and MU_BENCH_THRESHOLD.
+ *
+ * \return The number of benchmarks that regressed against the baseline.
+ */
+int mu_run_all_benches(void);
+
+//! Only run benchmarks whose name contains filter. NULL runs all.
+void mu_bench_set_filter(const char *filter);
+
+//! Number of samples per benchmark, default 15.
+void mu_bench_set_samples(int samples);
+
+//! Minimum duration of one sample in seconds, default 0.01.
+void mu_bench_set_min_time(double seconds);
+
+//! Pin to this CPU. -1 (the default) pins to the CPU the process is on.
+void mu_bench_set_cpu(int cpu);
+
+//! Write the results to path, one JSON object per benchmark.
+void mu_bench_set_output(const char *path);
+
+/*!
+ * \brief Compare the results against a file written by mu_bench_set_output().
+ *
+ * A benchmark whose median is more than threshold (e.g. 0.1 for 10%) slower
+ * than in the baseline is reported as a regression.
+ */
+void mu_bench_set_baseline(const char *path, double threshold);
+
+void mu_register_bench_impl(struct mu_bench *b);
+
 EXTERN_C_END
 
 #endif
@@ -1,5 +1,7 @@
+#define PCG_IMPL
 #include "c_ext.h"
 #include "pcg.h"
+#include "cpu.h"
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -11,13 +13,99 @@
 #include <windows.h>
 #endif
 
-// Based on PCG random alorithm. See pcg-random.org
-uint32_t pcg_next(uint64_t *state) {
-  uint64_t oldstate = *state;
-  *state = oldstate * 6364136223846793005ULL + 1;
-  uint32_t xorshifted = ((oldstate >> 18u) ^ oldstate) >> 27u;
-  uint32_t rot = oldstate >> 59u;
-  return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+#ifdef CPU_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+// Out-of-line pcg_next().
+#include "pcg_inline.h"
+
+#define PCG_MULT 6364136223846793005ULL
+#define PCG_LANES 8
+
+static void pcg_fill_generic(uint64_t *state, uint32_t *out, size_t count) {
+  uint64_t s = *state;
+  for(size_t i = 0; i < count; i++) {
+    out[i] = pcg_next(&s);
+  }
+  *state = s;
+}
+
+#ifdef CPU_X86_DISPATCH
+/**
+ * 64 bit lane-wise multiply by the constant m, from 32 x 32 -> 64 bit products.
+ */
+TARGET("avx2") static inline __m256i pcg_mul64(__m256i x, uint64_t m) {
+  __m256i lo = _mm256_set1_epi64x(m & 0xffffffff);
+  __m256i hi = _mm256_set1_epi64x(m >> 32);
+  __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), lo), _mm256_mul_epu32(x, hi));
+  return _mm256_add_epi64(_mm256_mul_epu32(x, lo), _mm256_slli_epi64(cross, 32));
+}
+
+/**
+ * The output function of pcg_next() on 4 states, result in the low 32 bits of
+ * each lane.
+ */
+TARGET("avx2") static inline __m256i pcg_output(__m256i s) {
+  __m256i x = _mm256_srli_epi64(_mm256_xor_si256(_mm256_srli_epi64(s, 18), s), 27);
+  x = _mm256_and_si256(x, _mm256_set1_epi64x(0xffffffff));
+  __m256i rot = _mm256_srli_epi64(s, 59);
+  __m256i left = _mm256_sub_epi64(_mm256_set1_epi64x(32), rot);
+  return _mm256_or_si256(_mm256_srlv_epi64(x, rot), _mm256_sllv_epi64(x, left));
+}
+
+/**
+ * Lane i runs the generator from step i and jumps PCG_LANES steps at a time,
+ * so the lanes together produce the sequential output.
+ */
+TARGET("avx2") static void pcg_fill_avx2(uint64_t *state, uint32_t *out, size_t count) {
+  if(count < 2 * PCG_LANES) {
+    pcg_fill_generic(state, out, count);
+    return;
+  }
+
+  uint64_t lanes[PCG_LANES];
+  uint64_t s = *state;
+  // Jump ahead: s * mult + inc applied PCG_LANES times.
+  uint64_t mult = 1, inc = 0;
+  for(int i = 0; i < PCG_LANES; i++) {
+    lanes[i] = s;
+    s = s * PCG_MULT + 1;
+    inc = inc * PCG_MULT + 1;
+    mult *= PCG_MULT;
+  }
+
+  __m256i s0 = _mm256_loadu_si256((const __m256i *)lanes);
+  __m256i s1 = _mm256_loadu_si256((const __m256i *)(lanes + 4));
+  __m256i c = _mm256_set1_epi64x(inc);
+  const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  size_t i = 0;
+  for(; i + PCG_LANES <= count; i += PCG_LANES) {
+    __m256i r0 = _mm256_permutevar8x32_epi32(pcg_output(s0), pack);
+    __m256i r1 = _mm256_permutevar8x32_epi32(pcg_output(s1), pack);
+    _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute2x128_si256(r0, r1, 0x20));
+    s0 = _mm256_add_epi64(pcg_mul64(s0, mult), c);
+    s1 = _mm256_add_epi64(pcg_mul64(s1, mult), c);
+  }
+
+  // Lane 0 holds the state for the next output.
+  _mm256_storeu_si256((__m256i *)lanes, s0);
+  *state = lanes[0];
+  pcg_fill_generic(state, out + i, count - i);
+}
+#endif
+
+static void (*pcg_fill_impl)(uint64_t *state, uint32_t *out, size_t count) = pcg_fill_generic;
+
+CONSTRUCTOR static void pcg_dispatch_init(void) {
+#ifdef CPU_X86_DISPATCH
+  if(cpu_features() & CPU_AVX2)
+    pcg_fill_impl = pcg_fill_avx2;
+#endif
+}
+
+void pcg_fill(uint64_t *state, uint32_t *out, size_t count) {
+  pcg_fill_impl(state, out, count);
 }
 
 uint64_t pcg_uniform(uint64_t *state, uint64_t bound) {
@@ -3,8 +3,29 @@
 
 #include <stdint.h>
 
-uint32_t pcg_next(uint64_t *state);
+// See rational.h, PGOLIB_INLINE makes pcg_next() static inline.
+#if defined(PGOLIB_INLINE) && !defined(PCG_IMPL)
+#define PCG_INLINE static inline
+#else
+#define PCG_INLINE
+#endif
+
+#include <stddef.h>
+
+PCG_INLINE uint32_t pcg_next(uint64_t *state);
+
+/**
+ * Fill out with the next count values of the generator, the same values that
+ * count calls of pcg_next() return. Dispatched to an AVX2 kernel where
+ * available (see cpu.h). pcg_uniform() still draws through pcg_next(), since
+ * its rejection loop needs a value at a time.
+ */
+void pcg_fill(uint64_t *state, uint32_t *out, size_t count);
 uint64_t pcg_uniform(uint64_t *state, uint64_t bound);
 void pcg_seed(uint64_t *state) ;
 
+#if defined(PGOLIB_INLINE) && !defined(PCG_IMPL)
+#include "pcg_inline.h"
+#endif
+
 #endif
@@ -0,0 +1,17 @@
+/*
+ * Definition of pcg_next(). Included by pcg.h with PGOLIB_INLINE, and by pcg.c
+ * for the out-of-line version.
+ */
+#ifndef PCG_INLINE_H
+#define PCG_INLINE_H
+
+// Based on PCG random alorithm. See pcg-random.org
+PCG_INLINE uint32_t pcg_next(uint64_t *state) {
+  uint64_t oldstate = *state;
+  *state = oldstate * 6364136223846793005ULL + 1;
+  uint32_t xorshifted = ((oldstate >> 18u) ^ oldstate) >> 27u;
+  uint32_t rot = oldstate >> 59u;
+  return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+#endif
@@ -1,101 +1,257 @@
+#define RATIONAL_IMPL
 #include "rational.h"
 #include "c_ext.h"
 
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
 
-#ifdef __clang__
-  #if !__has_builtin(__builtin_mul_overflow)
-    #warning "Compiler does not support generic overflow checking"
-    #ifdef __i386__
-      #define __builtin_mul_overflow __builtin_smulll_overflow
-      #define __builtin_add_overflow __builtin_saddll_overflow
-      #define __builtin_sub_overflow __builtin_ssubll_overflow
-    #else
-      #define __builtin_mul_overflow __builtin_smull_overflow
-      #define __builtin_add_overflow __builtin_saddl_overflow
-      #define __builtin_sub_overflow __builtin_ssubl_overflow
-    #endif
-  #endif
-#endif
+// Out-of-line copies of the inlinable primitives, RAT_INLINE is empty here.
+#include "rational_inline.h"
 
-#define CHK_BUILTIN 1
-#define CHK_NONE    2
-#define CHK_MANUAL  3
+static const char rat_digit_pairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
 
-#ifndef CHK_METHOD
-#define CHK_METHOD  CHK_BUILTIN
-#endif
+#define RAT_CHUNK_DIGITS 19
+#define RAT_CHUNK        10000000000000000000ULL
 
-rat_num_t chk_mul(rat_num_t a, rat_num_t b) {
-#if CHK_METHOD == CHK_BUILTIN
-  rat_num_t result;
-  if(__builtin_mul_overflow(a, b, &result))
-    panic("Multiplication overflow");
-  
-  return result;
-#elif CHK_METHOD == CHK_NONE
-  return a * b;
-#elif CHK_METHOD == CHK_MANUAL
-  rat_num_t result = a * b;
-  if(result / b != a)
-    panic("Multiplication overflow");
-  return result;
-#endif
+/**
+ * Write v backwards, ending just before end. If width is nonzero exactly that
+ * many digits are written (zero padded), otherwise as many as needed.
+ * Returns a pointer to the first digit.
+ */
+static char *rat_u64_digits(char *end, uint64_t v, int width) {
+  char *p = end;
+  char *stop = end - width;
+  while(v >= 100) {
+    const char *pair = rat_digit_pairs + (v % 100) * 2;
+    v /= 100;
+    *--p = pair[1];
+    *--p = pair[0];
+  }
+  if(v >= 10) {
+    const char *pair = rat_digit_pairs + v * 2;
+    *--p = pair[1];
+    *--p = pair[0];
+  } else {
+    *--p = '0' + v;
+  }
+  while(p > stop)
+    *--p = '0';
+  return p;
 }
 
-rat_num_t chk_add(rat_num_t a, rat_num_t b) {
-#if CHK_METHOD == CHK_BUILTIN
-  rat_num_t result;
-  if(__builtin_add_overflow(a, b, &result))
-    panic("Addition overflow");
-  
-  return result;
-#elif CHK_METHOD == CHK_NONE
-  return a + b;
-#elif CHK_METHOD == CHK_MANUAL
-  if(((unsigned rat_num_t)a >> (RAT_BITS - 1)) && ((unsigned rat_num_t)b >> (RAT_BITS - 1)))
-    panic("Addition overflow");
-  rat_num_t result = a + b;
-  return result;
-#endif
+size_t rat_num_fmt(char *buf, rat_num_t a) {
+  char tmp[RAT_NUM_STR_SIZE];
+  char *end = tmp + sizeof tmp;
+  rat_unum_t u = a < 0 ? -(rat_unum_t)a : (rat_unum_t)a;
+
+  // Peel off 19 digit chunks with one wide division each, then convert each
+  // chunk with 64 bit arithmetic.
+  char *p = end;
+  while(u >= RAT_CHUNK) {
+    rat_unum_t q = u / RAT_CHUNK;
+    p = rat_u64_digits(p, (uint64_t)(u - q * RAT_CHUNK), RAT_CHUNK_DIGITS);
+    u = q;
+  }
+  p = rat_u64_digits(p, (uint64_t)u, 0);
+  if(a < 0)
+    *--p = '-';
+
+  size_t len = end - p;
+  memcpy(buf, p, len);
+  buf[len] = '\0';
+  return len;
 }
 
-rat_num_t chk_sub(rat_num_t a, rat_num_t b) {
-#if CHK_METHOD == CHK_BUILTIN
-  rat_num_t result;
-  if(__builtin_sub_overflow(a, b, &result))
-    panic("Subtraction overflow");
-  
-  return result;
-#elif CHK_METHOD == CHK_NONE
-  return a - b;
-#elif CHK_METHOD == CHK_MANUAL
-  return a - b;
-#endif
+size_t rat_fmt(char *buf, const rational_t *r) {
+  size_t len = rat_num_fmt(buf, r->numerator);
+  buf[len++] = '/';
+  return len + rat_num_fmt(buf + len, r->divisor);
+}
+
+/**
+ * Separators between the elements of an array, see rat_parse_array().
+ */
+static inline bool rat_is_sep(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',';
+}
+
+size_t rat_fmt_array(char *buf, const rational_t *array, size_t count, char sep) {
+  assert(rat_is_sep(sep));
+  size_t len = 0;
+  for(size_t i = 0; i < count; i++) {
+    if(i)
+      buf[len++] = sep;
+    len += rat_fmt(buf + len, &array[i]);
+  }
+  buf[len] = '\0';
+  return len;
+}
+
+static const uint64_t rat_pow10[RAT_CHUNK_DIGITS + 1] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+  100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+  1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+  1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+  1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/**
+ * Parse up to max_digits decimal digits.
+ */
+static const char *rat_u64_parse(const char *s, int max_digits, uint64_t *out) {
+  uint64_t v = 0;
+  const char *stop = s + max_digits;
+  while(s != stop && (unsigned)(*s - '0') < 10) {
+    v = v * 10 + (*s - '0');
+    s++;
+  }
+  *out = v;
+  return s;
+}
+
+const char *rat_num_parse(const char *s, rat_num_t *out) {
+  bool neg = false;
+  if(*s == '-' || *s == '+') {
+    neg = *s == '-';
+    s++;
+  }
+
+  if((unsigned)(*s - '0') >= 10)
+    return NULL;
+
+  rat_unum_t limit = (rat_unum_t)1 << (RAT_BITS - 1);
+  if(!neg)
+    limit--;
+
+  // Accumulate 19 digits at a time in 64 bits, one wide multiply per chunk.
+  rat_unum_t u = 0;
+  for(;;) {
+    uint64_t chunk;
+    const char *e = rat_u64_parse(s, RAT_CHUNK_DIGITS, &chunk);
+    int digits = e - s;
+    if(digits == 0)
+      break;
+
+    rat_unum_t r;
+    if(__builtin_mul_overflow(u, rat_pow10[digits], &r) || __builtin_add_overflow(r, chunk, &r) || r > limit)
+      return NULL;
+    u = r;
+    s = e;
+
+    if(digits < RAT_CHUNK_DIGITS)
+      break;
+  }
+
+  *out = neg ? (rat_num_t)-u : (rat_num_t)u;
+  return s;
+}
+
+const char *rat_parse(const char *s, rational_t *r) {
+  s = rat_num_parse(s, &r->numerator);
+  if(!s)
+    return NULL;
+
+  r->divisor = 1;
+  if(*s == '/') {
+    s = rat_num_parse(s + 1, &r->divisor);
+    if(!s || r->divisor == 0)
+      return NULL;
+  }
+  return s;
+}
+
+size_t rat_parse_array(const char *s, rational_t *array, size_t count, const char **end) {
+  size_t i = 0;
+  while(i < count) {
+    while(rat_is_sep(*s))
+      s++;
+
+    const char *e = rat_parse(s, &array[i]);
+    if(!e)
+      break;
+    s = e;
+    i++;
+  }
+
+  if(end)
+    *end = s;
+  return i;
 }
 
 char *rat_str(rat_num_t a) {
-  static char buf[40];
-  
-  char *p = buf + 39;
-  *p-- = '\0';
+  static __thread char buf[RAT_NUM_STR_SIZE];
+  rat_num_fmt(buf, a);
+  return buf;
+}
+
+static ALWAYS_INLINE uint64_t rat_gcd_u64(uint64_t a, uint64_t b) {
+  if(a == 0)
+    return b;
+  if(b == 0)
+    return a;
+
+  int shift = __builtin_ctzll(a | b);
+  a >>= __builtin_ctzll(a);
   do {
-    int rest = a % 10;
-    a /= 10;
-    *p-- = rest + '0';
-  } while(a);
-  return p + 1;
+    b >>= __builtin_ctzll(b);
+    // Branch free: a = min, b = |difference|.
+    uint64_t m = a < b ? a : b;
+    b = a > b ? a - b : b - a;
+    a = m;
+  } while(b);
+  return a << shift;
+}
+
+#ifdef __LP64__
+static ALWAYS_INLINE int rat_ctz(rat_unum_t x) {
+  uint64_t lo = (uint64_t)x;
+  return lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll((uint64_t)(x >> 64));
 }
+#endif
 
+/**
+ * Binary (Stein's) gcd of the magnitudes. Switches to 64 bit arithmetic as
+ * soon as both operands fit, which for typical divisors is right away.
+ */
 rat_num_t rat_gcd(rat_num_t a, rat_num_t b) {
-  while (b != 0) {
-    rat_num_t t = b;
-    b = a % b;
-    a = t;
-  }
-  return a;
+  rat_unum_t ua = a < 0 ? -(rat_unum_t)a : (rat_unum_t)a;
+  rat_unum_t ub = b < 0 ? -(rat_unum_t)b : (rat_unum_t)b;
+#ifndef __LP64__
+  return rat_gcd_u64(ua, ub);
+#else
+  if((ua | ub) <= UINT64_MAX)
+    return rat_gcd_u64(ua, ub);
+  if(ua == 0)
+    return ub;
+  if(ub == 0)
+    return ua;
+
+  int shift = rat_ctz(ua | ub);
+  ua >>= rat_ctz(ua);
+  do {
+    ub >>= rat_ctz(ub);
+    rat_unum_t m = ua < ub ? ua : ub;
+    ub = ua > ub ? ua - ub : ub - ua;
+    ua = m;
+    if((ua | ub) <= UINT64_MAX)
+      return (rat_unum_t)rat_gcd_u64(ua, ub) << shift;
+  } while(ub);
+  return ua << shift;
+#endif
 }
 
 rat_num_t rat_pow_s(rat_num_t x, rat_num_t y) {
@@ -129,10 +285,10 @@ void rat_normalize(rational_t *r) {
   rat_num_t g = rat_gcd(r->numerator, r->divisor);
   r->numerator /= g;
   r->divisor   /= g;
-}
-
-double rat_to_d(const rational_t *r) {
-  return (double)r->numerator / (double)r->divisor;
+  if(r->divisor < 0) {
+    r->numerator = chk_sub(0, r->numerator);
+    r->divisor   = chk_sub(0, r->divisor);
+  }
 }
 
 void rat_add(rational_t *dst, const rational_t *inc) {
@@ -150,19 +306,6 @@ void rat_add(rational_t *dst, const rational_t *inc) {
   rat_normalize(dst);
 }
 
-void rat_add_fast(rational_t *dst, const rational_t *inc) {
-  if(dst->divisor != inc->divisor) {
-    rat_num_t g = rat_gcd(dst->divisor, inc->divisor);
-    rat_num_t dst_fac = inc->divisor / g;
-    rat_num_t inc_fac = dst->divisor / g;
-    dst->numerator = chk_add(chk_mul(dst->numerator, dst_fac), chk_mul(inc->numerator, inc_fac));
-    dst->divisor = chk_mul(dst->divisor, dst_fac);
-  } else {
-    dst->numerator = chk_add(dst->numerator, inc->numerator);
-  }
-}
-
-
 void rat_sub(rational_t *dst, const rational_t *inc) {
   rat_num_t g = rat_gcd(dst->divisor, inc->divisor);
   rat_num_t dst_fac = inc->divisor / g;
@@ -181,11 +324,6 @@ void rat_mul(rational_t *d, const rational_t *f) {
   rat_normalize(d);
 }
 
-void rat_mul_fast(rational_t *d, const rational_t *f) {
-  d->numerator = chk_mul(d->numerator, f->numerator);
-  d->divisor   = chk_mul(d->divisor,   f->divisor);
-}
-
 void rat_div(rational_t *d, const rational_t *f) {
   d->numerator = chk_mul(d->numerator, f->divisor);
   d->divisor =   chk_mul(d->divisor, f->numerator);
@@ -199,17 +337,62 @@ void rat_mul_s(rational_t *d, uint64_t s) {
   rat_normalize(d); 
 }
 
+/**
+ * Full product of two unsigned numbers, as hi:lo.
+ */
+static void rat_umul_wide(rat_unum_t a, rat_unum_t b, rat_unum_t *hi, rat_unum_t *lo) {
+  const int half = RAT_BITS / 2;
+  const rat_unum_t mask = ((rat_unum_t)1 << half) - 1;
+
+  rat_unum_t a0 = a & mask, a1 = a >> half;
+  rat_unum_t b0 = b & mask, b1 = b >> half;
+
+  rat_unum_t p00 = a0 * b0;
+  rat_unum_t p01 = a0 * b1;
+  rat_unum_t p10 = a1 * b0;
+  rat_unum_t p11 = a1 * b1;
+
+  rat_unum_t mid = (p00 >> half) + (p01 & mask) + (p10 & mask);
+  *lo = (p00 & mask) | (mid << half);
+  *hi = p11 + (p01 >> half) + (p10 >> half) + (mid >> half);
+}
+
 int rat_cmp(const rational_t *a, const rational_t *b) {
-  rat_num_t g = rat_gcd(a->divisor, b->divisor);
-  rat_num_t a_fac = b->divisor / g;
-  rat_num_t b_fac = a->divisor / g;
-  
-  rat_num_t an = chk_mul(a->numerator, a_fac);
-  rat_num_t bn = chk_mul(b->numerator, b_fac);
-  
-  return an > bn ? +1 : 
-         bn > an ? -1 : 
-                    0;  
+  // Components that fit in half the bits: the cross products can't overflow.
+  const rat_num_t small = (rat_num_t)1 << (RAT_BITS / 2 - 1);
+  if(a->numerator >= -small && a->numerator < small && a->divisor >= -small && a->divisor < small &&
+     b->numerator >= -small && b->numerator < small && b->divisor >= -small && b->divisor < small) {
+    rat_num_t an = a->numerator * b->divisor;
+    rat_num_t bn = b->numerator * a->divisor;
+    if((a->divisor < 0) != (b->divisor < 0)) {
+      an = -an;
+      bn = -bn;
+    }
+    return (an > bn) - (an < bn);
+  }
+
+  double da = rat_to_d(a);
+  double db = rat_to_d(b);
+  if(fabs(da - db) > RAT_D_MARGIN * (fabs(da) + fabs(db)))
+    return da > db ? +1 : -1;
+
+  // Exact: compare |a.n| * |b.d| with |b.n| * |a.d| in double width.
+  int sa = ((a->numerator > 0) - (a->numerator < 0)) * (a->divisor < 0 ? -1 : 1);
+  int sb = ((b->numerator > 0) - (b->numerator < 0)) * (b->divisor < 0 ? -1 : 1);
+  if(sa != sb || sa == 0)
+    return (sa > sb) - (sa < sb);
+
+  rat_unum_t an = a->numerator < 0 ? -(rat_unum_t)a->numerator : (rat_unum_t)a->numerator;
+  rat_unum_t ad = a->divisor < 0 ? -(rat_unum_t)a->divisor : (rat_unum_t)a->divisor;
+  rat_unum_t bn = b->numerator < 0 ? -(rat_unum_t)b->numerator : (rat_unum_t)b->numerator;
+  rat_unum_t bd = b->divisor < 0 ? -(rat_unum_t)b->divisor : (rat_unum_t)b->divisor;
+
+  rat_unum_t lh, ll, rh, rl;
+  rat_umul_wide(an, bd, &lh, &ll);
+  rat_umul_wide(bn, ad, &rh, &rl);
+
+  int c = lh != rh ? (lh > rh) - (lh < rh) : (ll > rl) - (ll < rl);
+  return sa * c;
 }
 
 /**
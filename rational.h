@@ -6,33 +6,66 @@
 
 #ifdef __LP64__
 typedef __int128 rat_num_t;
+typedef unsigned __int128 rat_unum_t;
 #else
 typedef int64_t rat_num_t;
+typedef uint64_t rat_unum_t;
 #endif
 
 #define RAT_BITS (sizeof(rat_num_t) * 8)
 
-rat_num_t chk_mul(rat_num_t a, rat_num_t b);
-rat_num_t chk_add(rat_num_t a, rat_num_t b);
-rat_num_t chk_sub(rat_num_t a, rat_num_t b);
+/*
+ * Define PGOLIB_INLINE to get static inline copies of the primitives marked
+ * RAT_INLINE (see rational_inline.h), so the compiler can fold them into their
+ * callers. The library still exports the out-of-line versions.
+ */
+#if defined(PGOLIB_INLINE) && !defined(RATIONAL_IMPL)
+#define RAT_INLINE static inline
+#else
+#define RAT_INLINE
+#endif
+
+RAT_INLINE rat_num_t chk_mul(rat_num_t a, rat_num_t b);
+RAT_INLINE rat_num_t chk_add(rat_num_t a, rat_num_t b);
+RAT_INLINE rat_num_t chk_sub(rat_num_t a, rat_num_t b);
 
 typedef struct rational {
   rat_num_t numerator;
   rat_num_t divisor;
 } rational_t;
 
+//! Greatest common divisor, never negative.
 rat_num_t rat_gcd(rat_num_t a, rat_num_t b);
 rat_num_t rat_pow_s(rat_num_t x, rat_num_t y);
 void rat_zero(rational_t *r, size_t count);
+/**
+ * Reduce to lowest terms with a positive divisor, the sign goes to the
+ * numerator. rat_vec_normalize() and the rat_mat_ results follow the same
+ * convention.
+ */
 void rat_normalize(rational_t *r);
-double rat_to_d(const rational_t *r) ;
+RAT_INLINE double rat_to_d(const rational_t *r);
 void rat_add(rational_t *dst, const rational_t *inc);
-void rat_add_fast(rational_t *dst, const rational_t *inc);
+RAT_INLINE void rat_add_fast(rational_t *dst, const rational_t *inc);
 void rat_sub(rational_t *dst, const rational_t *inc);
-void rat_mul_fast(rational_t *d, const rational_t *f);
+RAT_INLINE void rat_mul_fast(rational_t *d, const rational_t *f);
 void rat_mul(rational_t *d, const rational_t *f);
 void rat_div(rational_t *d, const rational_t *f);
 void rat_mul_s(rational_t *d, uint64_t s);
+
+/**
+ * Relative distance beyond which two rat_to_d() results are known to be
+ * ordered like the exact values. Each conversion is off by at most a few ulp.
+ */
+#define RAT_D_MARGIN 1e-14
+
+/**
+ * \brief Compare two rationals. Returns +1, 0 or -1.
+ *
+ * Never overflows and takes no gcd: small components are cross multiplied
+ * directly, otherwise rat_to_d() decides unless the values are very close, and
+ * then the cross products are compared in double width.
+ */
 int rat_cmp(const rational_t *a, const rational_t *b);
 
 /**
@@ -41,8 +74,66 @@ int rat_cmp(const rational_t *a, const rational_t *b);
 rat_num_t rat_lcm(const rational_t *array, size_t count);
 
 /**
- * Convert to string.
+ * Buffer sizes, including the terminating NUL, for rat_num_fmt() and rat_fmt().
+ */
+#define RAT_NUM_STR_SIZE 42
+#define RAT_STR_SIZE     (2 * RAT_NUM_STR_SIZE)
+
+/**
+ * Convert to string. The buffer is per thread and overwritten on the next call.
  */
 char *rat_str(rat_num_t a);
 
+/**
+ * \brief Format a number in decimal.
+ *
+ * \arg buf
+ *   At least RAT_NUM_STR_SIZE bytes.
+ *
+ * \return The length of the string, not counting the NUL.
+ */
+size_t rat_num_fmt(char *buf, rat_num_t a);
+
+/**
+ * Format as "numerator/divisor". buf must hold at least RAT_STR_SIZE bytes.
+ */
+size_t rat_fmt(char *buf, const rational_t *r);
+
+/**
+ * Format count rationals separated by sep into one string.
+ * buf must hold at least count * RAT_STR_SIZE + 1 bytes; the string is always
+ * NUL terminated, so count 0 writes an empty one. sep must be a comma or
+ * whitespace (' ', '\t', '\n' or '\r'), the separators rat_parse_array()
+ * reads back.
+ */
+size_t rat_fmt_array(char *buf, const rational_t *array, size_t count, char sep);
+
+/**
+ * \brief Parse a decimal number with optional sign.
+ *
+ * \return Pointer past the last digit, or NULL if there are no digits or the
+ *   value doesn't fit in rat_num_t.
+ */
+const char *rat_num_parse(const char *s, rat_num_t *out);
+
+/**
+ * Parse "numerator/divisor" or just "numerator". The result is not normalized.
+ * Returns NULL on error or a zero divisor.
+ */
+const char *rat_parse(const char *s, rational_t *r);
+
+/**
+ * \brief Parse up to count rationals separated by whitespace or commas.
+ *
+ * \arg end
+ *   If not NULL, set to the first unparsed character.
+ *
+ * \return The number of rationals parsed.
+ */
+size_t rat_parse_array(const char *s, rational_t *array, size_t count, const char **end);
+
+#if defined(PGOLIB_INLINE) && !defined(RATIONAL_IMPL)
+#include "rational_inline.h"
+#endif
+
 #endif
@@ -0,0 +1,124 @@
+/*
+ * Definitions of the rational primitives that callers may want inlined.
+ *
+ * With PGOLIB_INLINE defined, rational.h includes this file and RAT_INLINE is
+ * static inline. rational.c always includes it with RAT_INLINE empty, so the
+ * library keeps exporting the out-of-line versions.
+ */
+#ifndef RATIONAL_INLINE_H
+#define RATIONAL_INLINE_H
+
+#include "c_ext.h"
+
+#ifdef __clang__
+  #if !__has_builtin(__builtin_mul_overflow)
+    #warning "Compiler does not support generic overflow checking"
+    #define RAT_OVERFLOW_FALLBACK
+    #ifdef __i386__
+      #define __builtin_mul_overflow __builtin_smulll_overflow
+      #define __builtin_add_overflow __builtin_saddll_overflow
+      #define __builtin_sub_overflow __builtin_ssubll_overflow
+    #else
+      #define __builtin_mul_overflow __builtin_smull_overflow
+      #define __builtin_add_overflow __builtin_saddl_overflow
+      #define __builtin_sub_overflow __builtin_ssubl_overflow
+    #endif
+  #endif
+#endif
+
+#define CHK_BUILTIN 1
+#define CHK_NONE    2
+#define CHK_MANUAL  3
+
+#ifndef CHK_METHOD
+#define CHK_METHOD  CHK_BUILTIN
+#define RAT_CHK_DEFAULT
+#endif
+
+RAT_INLINE rat_num_t chk_mul(rat_num_t a, rat_num_t b) {
+#if CHK_METHOD == CHK_BUILTIN
+  rat_num_t result;
+  if(__builtin_mul_overflow(a, b, &result))
+    panic("Multiplication overflow");
+  
+  return result;
+#elif CHK_METHOD == CHK_NONE
+  return a * b;
+#elif CHK_METHOD == CHK_MANUAL
+  rat_num_t result = a * b;
+  if(result / b != a)
+    panic("Multiplication overflow");
+  return result;
+#endif
+}
+
+RAT_INLINE rat_num_t chk_add(rat_num_t a, rat_num_t b) {
+#if CHK_METHOD == CHK_BUILTIN
+  rat_num_t result;
+  if(__builtin_add_overflow(a, b, &result))
+    panic("Addition overflow");
+  
+  return result;
+#elif CHK_METHOD == CHK_NONE
+  return a + b;
+#elif CHK_METHOD == CHK_MANUAL
+  if(((rat_unum_t)a >> (RAT_BITS - 1)) && ((rat_unum_t)b >> (RAT_BITS - 1)))
+    panic("Addition overflow");
+  rat_num_t result = a + b;
+  return result;
+#endif
+}
+
+RAT_INLINE rat_num_t chk_sub(rat_num_t a, rat_num_t b) {
+#if CHK_METHOD == CHK_BUILTIN
+  rat_num_t result;
+  if(__builtin_sub_overflow(a, b, &result))
+    panic("Subtraction overflow");
+  
+  return result;
+#elif CHK_METHOD == CHK_NONE
+  return a - b;
+#elif CHK_METHOD == CHK_MANUAL
+  return a - b;
+#endif
+}
+
+RAT_INLINE double rat_to_d(const rational_t *r) {
+  return (double)r->numerator / (double)r->divisor;
+}
+
+RAT_INLINE void rat_add_fast(rational_t *dst, const rational_t *inc) {
+  if(dst->divisor != inc->divisor) {
+    rat_num_t g = rat_gcd(dst->divisor, inc->divisor);
+    rat_num_t dst_fac = inc->divisor / g;
+    rat_num_t inc_fac = dst->divisor / g;
+    dst->numerator = chk_add(chk_mul(dst->numerator, dst_fac), chk_mul(inc->numerator, inc_fac));
+    dst->divisor = chk_mul(dst->divisor, dst_fac);
+  } else {
+    dst->numerator = chk_add(dst->numerator, inc->numerator);
+  }
+}
+
+RAT_INLINE void rat_mul_fast(rational_t *d, const rational_t *f) {
+  d->numerator = chk_mul(d->numerator, f->numerator);
+  d->divisor   = chk_mul(d->divisor,   f->divisor);
+}
+
+// Callers that include this through rational.h don't get our macros.
+#ifndef RATIONAL_IMPL
+  #ifdef RAT_OVERFLOW_FALLBACK
+    #undef __builtin_mul_overflow
+    #undef __builtin_add_overflow
+    #undef __builtin_sub_overflow
+    #undef RAT_OVERFLOW_FALLBACK
+  #endif
+  #ifdef RAT_CHK_DEFAULT
+    #undef CHK_METHOD
+    #undef RAT_CHK_DEFAULT
+  #endif
+  #undef CHK_BUILTIN
+  #undef CHK_NONE
+  #undef CHK_MANUAL
+#endif
+
+#endif
@@ -0,0 +1,354 @@
+#include "rational_mat.h"
+#include "c_ext.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  RAT_MAT_OK,
+  RAT_MAT_SINGULAR,
+  RAT_MAT_OVERFLOW
+};
+
+static void *rat_mat_alloc(size_t size) {
+  void *p = malloc(size);
+  if(size && !p)
+    panic("Out of memory");
+  return p;
+}
+
+void rat_mat_init(rat_mat_t *m, size_t rows, size_t cols) {
+  m->rows = rows;
+  m->cols = cols;
+  m->data = rat_mat_alloc(rows * cols * sizeof(rational_t));
+
+  rat_zero(m->data, rows * cols);
+}
+
+void rat_mat_free(rat_mat_t *m) {
+  free(m->data);
+  m->data = NULL;
+  m->rows = 0;
+  m->cols = 0;
+}
+
+void rat_mat_identity(rat_mat_t *m) {
+  rat_zero(m->data, m->rows * m->cols);
+  for(size_t i = 0; i < m->rows && i < m->cols; i++) {
+    RAT_MAT_at(m, i, i).numerator = 1;
+  }
+}
+
+/**
+ * \brief Fraction-free elimination of the n x (n + m) augmented matrix aug.
+ *
+ * Each row is scaled to integers by the LCM of its divisors. After the
+ * elimination the left block is upper triangular and its last diagonal
+ * element D is the determinant of the scaled matrix (up to sign). Back
+ * substitution then computes D * x, which is integral, so every division is
+ * exact.
+ *
+ * Returns RAT_MAT_OVERFLOW as soon as any intermediate doesn't fit.
+ */
+static int rat_mat_bareiss(const rational_t *aug, size_t n, size_t m, rational_t *x, rational_t *det) {
+  size_t w = n + m;
+  rat_num_t *mat = rat_mat_alloc(n * w * sizeof(rat_num_t));
+  rat_num_t *scale = rat_mat_alloc(n * sizeof(rat_num_t));
+  rat_num_t *sol = rat_mat_alloc(n * sizeof(rat_num_t));
+  rat_num_t *piv = rat_mat_alloc((n + 1) * sizeof(rat_num_t));
+  size_t *synced = rat_mat_alloc(n * sizeof(size_t));
+  int status = RAT_MAT_OVERFLOW;
+
+  for(size_t i = 0; i < n; i++) {
+    const rational_t *src = aug + i * w;
+    rat_num_t lcm = 1;
+    for(size_t j = 0; j < w; j++) {
+      rat_num_t g = rat_gcd(lcm, src[j].divisor);
+      if(__builtin_mul_overflow(lcm, src[j].divisor / g, &lcm))
+        goto done;
+    }
+    if(lcm < 0)
+      lcm = -lcm;
+    scale[i] = lcm;
+
+    rat_num_t *dst = mat + i * w;
+    for(size_t j = 0; j < w; j++) {
+      if(__builtin_mul_overflow(src[j].numerator, lcm / src[j].divisor, &dst[j]))
+        goto done;
+    }
+  }
+
+  // Bareiss step k multiplies a row whose column k is zero by pivot_k / pivot_k-1.
+  // Those rescales telescope, so such rows are left alone and brought up to
+  // date only when they are needed. piv[k] is the pivot of step k - 1 (piv[0]
+  // is 1) and synced[i] the first step row i has not seen yet.
+  int sign = 1;
+  piv[0] = 1;
+  for(size_t i = 0; i < n; i++)
+    synced[i] = 0;
+
+  for(size_t k = 0; k < n; k++) {
+    // Sync the candidate rows and pick the smallest nonzero pivot, which keeps
+    // the products small.
+    size_t p = n;
+    for(size_t i = k; i < n; i++) {
+      rat_num_t *ri = mat + i * w;
+      if(ri[k] == 0)
+        continue;
+
+      if(synced[i] < k) {
+        rat_num_t num = piv[k];
+        rat_num_t den = piv[synced[i]];
+        for(size_t j = k; j < w; j++) {
+          if(ri[j] == 0)
+            continue;
+          if(__builtin_mul_overflow(ri[j], num, &ri[j]))
+            goto done;
+          ri[j] /= den;
+        }
+        synced[i] = k;
+      }
+
+      rat_num_t v = ri[k] < 0 ? -ri[k] : ri[k];
+      if(p == n || v < (mat[p * w + k] < 0 ? -mat[p * w + k] : mat[p * w + k]))
+        p = i;
+    }
+
+    if(p == n) {
+      status = RAT_MAT_SINGULAR;
+      goto done;
+    }
+
+    if(p != k) {
+      for(size_t j = k; j < w; j++) {
+        rat_num_t t = mat[k * w + j];
+        mat[k * w + j] = mat[p * w + j];
+        mat[p * w + j] = t;
+      }
+      size_t t = synced[k];
+      synced[k] = synced[p];
+      synced[p] = t;
+      sign = -sign;
+    }
+
+    const rat_num_t *rk = mat + k * w;
+    rat_num_t pivot = rk[k];
+    rat_num_t prev = piv[k];
+    for(size_t i = k + 1; i < n; i++) {
+      rat_num_t *ri = mat + i * w;
+      rat_num_t lead = ri[k];
+      if(lead == 0)
+        continue;
+
+      for(size_t j = k + 1; j < w; j++) {
+        if(ri[j] == 0 && rk[j] == 0)
+          continue;
+
+        rat_num_t a, b;
+        if(__builtin_mul_overflow(ri[j], pivot, &a) ||
+           __builtin_mul_overflow(lead, rk[j], &b) ||
+           __builtin_sub_overflow(a, b, &a))
+          goto done;
+        ri[j] = a / prev;
+      }
+      ri[k] = 0;
+      synced[i] = k + 1;
+    }
+    piv[k + 1] = pivot;
+  }
+
+  rat_num_t d = mat[(n - 1) * w + n - 1];
+  for(size_t c = 0; c < m; c++) {
+    for(size_t i = n; i-- > 0; ) {
+      const rat_num_t *ri = mat + i * w;
+      rat_num_t acc;
+      if(__builtin_mul_overflow(d, ri[n + c], &acc))
+        goto done;
+
+      for(size_t j = i + 1; j < n; j++) {
+        if(ri[j] == 0)
+          continue;
+
+        rat_num_t t;
+        if(__builtin_mul_overflow(ri[j], sol[j], &t) ||
+           __builtin_sub_overflow(acc, t, &acc))
+          goto done;
+      }
+      sol[i] = acc / ri[i];
+    }
+
+    for(size_t i = 0; i < n; i++) {
+      rational_t *r = &x[i * m + c];
+      r->numerator = sol[i];
+      r->divisor = d;
+      rat_normalize(r);
+    }
+  }
+
+  if(det) {
+    det->numerator = sign * d;
+    det->divisor = 1;
+    for(size_t i = 0; i < n; i++) {
+      rational_t s = { scale[i], 1 };
+      rat_div(det, &s);
+    }
+    rat_normalize(det);
+  }
+  status = RAT_MAT_OK;
+
+done:
+  free(mat);
+  free(scale);
+  free(sol);
+  free(piv);
+  free(synced);
+  return status;
+}
+
+/**
+ * Ordinary Gaussian elimination with the overflow-checked operations.
+ */
+static bool rat_mat_gauss(const rational_t *aug, size_t n, size_t m, rational_t *x, rational_t *det) {
+  size_t w = n + m;
+  rational_t *mat = rat_mat_alloc(n * w * sizeof(rational_t));
+  memcpy(mat, aug, n * w * sizeof(rational_t));
+  rational_t d = { 1, 1 };
+  bool ok = false;
+
+  for(size_t k = 0; k < n; k++) {
+    size_t p = k;
+    while(p < n && mat[p * w + k].numerator == 0)
+      p++;
+
+    if(p == n)
+      goto done;
+
+    if(p != k) {
+      for(size_t j = k; j < w; j++) {
+        rational_t t = mat[k * w + j];
+        mat[k * w + j] = mat[p * w + j];
+        mat[p * w + j] = t;
+      }
+      d.numerator = -d.numerator;
+    }
+
+    const rational_t *rk = mat + k * w;
+    rat_mul(&d, &rk[k]);
+    for(size_t i = k + 1; i < n; i++) {
+      rational_t *ri = mat + i * w;
+      if(ri[k].numerator == 0)
+        continue;
+
+      rational_t f = ri[k];
+      rat_div(&f, &rk[k]);
+      for(size_t j = k + 1; j < w; j++) {
+        rational_t t = rk[j];
+        rat_mul(&t, &f);
+        rat_sub(&ri[j], &t);
+      }
+      ri[k].numerator = 0;
+      ri[k].divisor = 1;
+    }
+  }
+
+  for(size_t c = 0; c < m; c++) {
+    for(size_t i = n; i-- > 0; ) {
+      const rational_t *ri = mat + i * w;
+      rational_t acc = ri[n + c];
+      for(size_t j = i + 1; j < n; j++) {
+        rational_t t = ri[j];
+        rat_mul(&t, &x[j * m + c]);
+        rat_sub(&acc, &t);
+      }
+      rat_div(&acc, &ri[i]);
+      rat_normalize(&acc);
+      x[i * m + c] = acc;
+    }
+  }
+  ok = true;
+
+done:
+  if(det) {
+    *det = ok ? d : (rational_t){ 0, 1 };
+    rat_normalize(det);
+  }
+  free(mat);
+  return ok;
+}
+
+static bool rat_mat_reduce(const rational_t *aug, size_t n, size_t m, rational_t *x, rational_t *det) {
+  if(n == 0) {
+    if(det) {
+      det->numerator = 1;
+      det->divisor = 1;
+    }
+    return true;
+  }
+
+  switch(rat_mat_bareiss(aug, n, m, x, det)) {
+    case RAT_MAT_OK:
+      return true;
+    case RAT_MAT_SINGULAR:
+      if(det) {
+        det->numerator = 0;
+        det->divisor = 1;
+      }
+      return false;
+    default:
+      return rat_mat_gauss(aug, n, m, x, det);
+  }
+}
+
+/**
+ * Build the augmented matrix [a | b].
+ */
+static rational_t *rat_mat_augment(const rat_mat_t *a, const rational_t *b, size_t m) {
+  size_t n = a->rows;
+  size_t w = n + m;
+  rational_t *aug = rat_mat_alloc(n * w * sizeof(rational_t));
+  for(size_t i = 0; i < n; i++) {
+    memcpy(aug + i * w, a->data + i * n, n * sizeof(rational_t));
+    if(m)
+      memcpy(aug + i * w + n, b + i * m, m * sizeof(rational_t));
+  }
+  return aug;
+}
+
+bool rat_mat_solve(const rat_mat_t *a, const rational_t *b, rational_t *x) {
+  assert(a->rows == a->cols);
+
+  rational_t *aug = rat_mat_augment(a, b, 1);
+  bool ok = rat_mat_reduce(aug, a->rows, 1, x, NULL);
+  free(aug);
+  return ok;
+}
+
+bool rat_mat_solve_mat(const rat_mat_t *a, const rat_mat_t *b, rat_mat_t *x) {
+  assert(a->rows == a->cols);
+  assert(b->rows == a->rows);
+  assert(x->rows == b->rows && x->cols == b->cols);
+
+  rational_t *aug = rat_mat_augment(a, b->data, b->cols);
+  bool ok = rat_mat_reduce(aug, a->rows, b->cols, x->data, NULL);
+  free(aug);
+  return ok;
+}
+
+void rat_mat_det(const rat_mat_t *a, rational_t *det) {
+  assert(a->rows == a->cols);
+
+  rat_mat_reduce(a->data, a->rows, 0, NULL, det);
+}
+
+bool rat_mat_inverse(const rat_mat_t *a, rat_mat_t *inv) {
+  assert(a->rows == a->cols);
+  assert(inv->rows == a->rows && inv->cols == a->cols);
+
+  rat_mat_t id;
+  rat_mat_init(&id, a->rows, a->cols);
+  rat_mat_identity(&id);
+  bool ok = rat_mat_solve_mat(a, &id, inv);
+  rat_mat_free(&id);
+  return ok;
+}
@@ -0,0 +1,67 @@
+#ifndef RATIONAL_MAT_H
+#define RATIONAL_MAT_H
+
+#include "rational.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * \brief Dense matrix of rationals, row major.
+ *
+ * The solver, determinant and inverse scale every row to integers by the lcm
+ * of its divisors and then run fraction-free (Bareiss) elimination on the
+ * numerators. The lcm is taken inline with overflow checks rather than with
+ * rat_lcm(), so a row whose lcm doesn't fit goes to the fallback below.
+ * Every division in the elimination is exact, so no gcd is needed until the
+ * results are converted back to rationals. If an intermediate value doesn't
+ * fit in rat_num_t, the computation is redone with ordinary Gaussian
+ * elimination using the overflow-checked rat_ operations.
+ */
+typedef struct rat_mat {
+  rational_t *data;
+  size_t rows;
+  size_t cols;
+} rat_mat_t;
+
+#define RAT_MAT_at(mat_ptr, row, col) \
+  ((mat_ptr)->data[(row) * (mat_ptr)->cols + (col)])
+
+/**
+ * Allocate a rows x cols matrix with all elements set to 0/1.
+ */
+void rat_mat_init(rat_mat_t *m, size_t rows, size_t cols);
+void rat_mat_free(rat_mat_t *m);
+void rat_mat_identity(rat_mat_t *m);
+
+/**
+ * \brief Solve a x = b.
+ *
+ * \arg a
+ *   Square matrix.
+ *
+ * \arg b, x
+ *   Vectors of a->rows elements. x receives the normalized solution.
+ *
+ * \return false if a is singular.
+ */
+bool rat_mat_solve(const rat_mat_t *a, const rational_t *b, rational_t *x);
+
+/**
+ * Solve a x = b for every column of b. x must have the same shape as b.
+ * Returns false if a is singular.
+ */
+bool rat_mat_solve_mat(const rat_mat_t *a, const rat_mat_t *b, rat_mat_t *x);
+
+/**
+ * Determinant of a square matrix, normalized.
+ */
+void rat_mat_det(const rat_mat_t *a, rational_t *det);
+
+/**
+ * Inverse of a square matrix. inv must have the same shape as a.
+ * Returns false if a is singular.
+ */
+bool rat_mat_inverse(const rat_mat_t *a, rat_mat_t *inv);
+
+#endif
@@ -0,0 +1,205 @@
+#include "rational_sort.h"
+#include "c_ext.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Ranges of at most this many items are finished with insertion sort.
+#define RAT_SORT_SMALL 16
+
+typedef struct rat_sort_item {
+  double key;
+  size_t index;
+} rat_sort_item_t;
+
+static inline bool rat_sort_less(const rat_sort_item_t *x, const rat_sort_item_t *y, const rational_t *array) {
+  double diff = x->key - y->key;
+  double margin = RAT_D_MARGIN * (fabs(x->key) + fabs(y->key));
+  if(diff > margin)
+    return false;
+  if(diff < -margin)
+    return true;
+  return rat_cmp(&array[x->index], &array[y->index]) < 0;
+}
+
+static inline void rat_sort_swap(rat_sort_item_t *x, rat_sort_item_t *y) {
+  rat_sort_item_t t = *x;
+  *x = *y;
+  *y = t;
+}
+
+static void rat_sort_insertion(rat_sort_item_t *v, size_t n, const rational_t *array) {
+  for(size_t i = 1; i < n; i++) {
+    rat_sort_item_t t = v[i];
+    size_t j = i;
+    for(; j > 0 && rat_sort_less(&t, &v[j - 1], array); j--) {
+      v[j] = v[j - 1];
+    }
+    v[j] = t;
+  }
+}
+
+static void rat_sort_sift(rat_sort_item_t *v, size_t root, size_t n, const rational_t *array) {
+  for(;;) {
+    size_t child = 2 * root + 1;
+    if(child >= n)
+      return;
+    if(child + 1 < n && rat_sort_less(&v[child], &v[child + 1], array))
+      child++;
+    if(!rat_sort_less(&v[root], &v[child], array))
+      return;
+    rat_sort_swap(&v[root], &v[child]);
+    root = child;
+  }
+}
+
+static void rat_sort_heap(rat_sort_item_t *v, size_t n, const rational_t *array) {
+  for(size_t i = n / 2; i-- > 0; ) {
+    rat_sort_sift(v, i, n, array);
+  }
+  for(size_t i = n; i-- > 1; ) {
+    rat_sort_swap(&v[0], &v[i]);
+    rat_sort_sift(v, 0, i, array);
+  }
+}
+
+/**
+ * Hoare partition around the median of three. Returns j with 0 <= j < n - 1
+ * such that v[0..j] are not greater and v[j+1..n) not smaller than the pivot.
+ */
+static size_t rat_sort_partition(rat_sort_item_t *v, size_t n, const rational_t *array) {
+  size_t mid = n / 2;
+  if(rat_sort_less(&v[mid], &v[0], array))
+    rat_sort_swap(&v[mid], &v[0]);
+  if(rat_sort_less(&v[n - 1], &v[mid], array)) {
+    rat_sort_swap(&v[n - 1], &v[mid]);
+    if(rat_sort_less(&v[mid], &v[0], array))
+      rat_sort_swap(&v[mid], &v[0]);
+  }
+
+  rat_sort_item_t pivot = v[mid];
+  size_t i = 0, j = n - 1;
+  for(;;) {
+    while(rat_sort_less(&v[i], &pivot, array))
+      i++;
+    while(rat_sort_less(&pivot, &v[j], array))
+      j--;
+    if(i >= j)
+      return j;
+    rat_sort_swap(&v[i], &v[j]);
+    i++;
+    j--;
+  }
+}
+
+/**
+ * Introsort: quicksort, falling back to heapsort when the recursion gets too
+ * deep.
+ */
+static void rat_sort_items(rat_sort_item_t *v, size_t n, int depth, const rational_t *array) {
+  while(n > RAT_SORT_SMALL) {
+    if(depth-- == 0) {
+      rat_sort_heap(v, n, array);
+      return;
+    }
+
+    size_t j = rat_sort_partition(v, n, array) + 1;
+    // Recurse into the smaller half, loop on the larger.
+    if(j < n - j) {
+      rat_sort_items(v, j, depth, array);
+      v += j;
+      n -= j;
+    } else {
+      rat_sort_items(v + j, n - j, depth, array);
+      n = j;
+    }
+  }
+  rat_sort_insertion(v, n, array);
+}
+
+static void rat_select_items(rat_sort_item_t *v, size_t n, size_t k, int depth, const rational_t *array) {
+  while(n > RAT_SORT_SMALL) {
+    if(depth-- == 0) {
+      rat_sort_heap(v, n, array);
+      return;
+    }
+
+    size_t j = rat_sort_partition(v, n, array) + 1;
+    if(k < j) {
+      n = j;
+    } else {
+      v += j;
+      n -= j;
+      k -= j;
+    }
+  }
+  rat_sort_insertion(v, n, array);
+}
+
+static int rat_sort_depth(size_t n) {
+  int depth = 0;
+  while(n >>= 1)
+    depth++;
+  return 2 * depth;
+}
+
+static rat_sort_item_t *rat_sort_keys(const rational_t *array, size_t count) {
+  rat_sort_item_t *items = malloc(count * sizeof(rat_sort_item_t));
+  if(!items)
+    panic("Out of memory");
+
+  for(size_t i = 0; i < count; i++) {
+    items[i].key = rat_to_d(&array[i]);
+    items[i].index = i;
+  }
+  return items;
+}
+
+/**
+ * Reorder array to match the order of the items.
+ */
+static void rat_sort_apply(rational_t *array, size_t count, rat_sort_item_t *items) {
+  rational_t *tmp = malloc(count * sizeof(rational_t));
+  if(!tmp)
+    panic("Out of memory");
+
+  for(size_t i = 0; i < count; i++) {
+    tmp[i] = array[items[i].index];
+  }
+  memcpy(array, tmp, count * sizeof(rational_t));
+  free(tmp);
+  free(items);
+}
+
+void rat_sort(rational_t *array, size_t count) {
+  if(count < 2)
+    return;
+
+  rat_sort_item_t *items = rat_sort_keys(array, count);
+  rat_sort_items(items, count, rat_sort_depth(count), array);
+  rat_sort_apply(array, count, items);
+}
+
+void rat_partial_sort(rational_t *array, size_t count, size_t k) {
+  if(k > count)
+    k = count;
+  if(k == 0 || count < 2)
+    return;
+
+  rat_sort_item_t *items = rat_sort_keys(array, count);
+  if(k < count)
+    rat_select_items(items, count, k, rat_sort_depth(count), array);
+  rat_sort_items(items, k, rat_sort_depth(k), array);
+  rat_sort_apply(array, count, items);
+}
+
+void rat_select(rational_t *array, size_t count, size_t k) {
+  if(k >= count || count < 2)
+    return;
+
+  rat_sort_item_t *items = rat_sort_keys(array, count);
+  rat_select_items(items, count, k, rat_sort_depth(count), array);
+  rat_sort_apply(array, count, items);
+}
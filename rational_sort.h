@@ -0,0 +1,30 @@
+#ifndef RATIONAL_SORT_H
+#define RATIONAL_SORT_H
+
+#include "rational.h"
+
+#include <stddef.h>
+
+/**
+ * \brief Sort an array of rationals in ascending order.
+ *
+ * Each element is converted with rat_to_d() once. Elements are ordered by
+ * those keys, and only keys too close to call are compared exactly with
+ * rat_cmp(). Not stable.
+ */
+void rat_sort(rational_t *array, size_t count);
+
+/**
+ * Move the k smallest elements, in ascending order, to the front of the
+ * array. The order of the rest is unspecified.
+ */
+void rat_partial_sort(rational_t *array, size_t count, size_t k);
+
+/**
+ * \brief Put the element that would be at index k in the sorted array there.
+ *
+ * Elements before it are not greater and elements after it are not smaller.
+ */
+void rat_select(rational_t *array, size_t count, size_t k);
+
+#endif
@@ -0,0 +1,459 @@
+#include "rational_vec.h"
+#include "c_ext.h"
+#include "params.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Elements are processed in blocks. A block takes the unchecked path when all
+// of its components are in [-RAT_SMALL, RAT_SMALL), so that products and sums
+// of two products can't overflow.
+#define RAT_VEC_BLOCK 64
+#define RAT_HALF_BITS (RAT_BITS / 2)
+#define RAT_SMALL     ((rat_num_t)1 << (RAT_HALF_BITS - 2))
+
+static inline bool rat_small(rat_num_t x) {
+  return (((rat_unum_t)x + RAT_SMALL) >> (RAT_HALF_BITS - 1)) == 0;
+}
+
+static inline bool rat_vec_small(const rat_num_t *x, size_t begin, size_t end) {
+  rat_unum_t bad = 0;
+  for(size_t i = begin; i < end; i++) {
+    bad |= ((rat_unum_t)x[i] + RAT_SMALL) >> (RAT_HALF_BITS - 1);
+  }
+  return bad == 0;
+}
+
+static inline bool rat_vec_block_small(const rat_vec_t *a, const rat_vec_t *b, size_t begin, size_t end) {
+  return rat_vec_small(a->numerator, begin, end) && rat_vec_small(a->divisor, begin, end) &&
+         rat_vec_small(b->numerator, begin, end) && rat_vec_small(b->divisor, begin, end);
+}
+
+/**
+ * Binary GCD, much cheaper than repeated 128 bit modulo.
+ */
+static inline uint64_t rat_gcd64(uint64_t a, uint64_t b) {
+  if(a == 0)
+    return b;
+  if(b == 0)
+    return a;
+
+  int shift = __builtin_ctzll(a | b);
+  a >>= __builtin_ctzll(a);
+  do {
+    b >>= __builtin_ctzll(b);
+    // Branch free: a = min, b = |difference|.
+    uint64_t m = a < b ? a : b;
+    b = a > b ? a - b : b - a;
+    a = m;
+  } while(b);
+
+  return a << shift;
+}
+
+// Number of gcds rat_gcd64_batch() runs side by side.
+#define RAT_GCD_LANES 4
+
+/**
+ * RAT_GCD_LANES binary gcds at once. Each gcd is a chain of dependent steps;
+ * interleaving independent ones lets them overlap in the pipeline. Lanes that
+ * finish early are held by a select until the slowest one is done.
+ */
+static inline void rat_gcd64_batch(uint64_t *g, const uint64_t *a, const uint64_t *b) {
+  uint64_t x[RAT_GCD_LANES], y[RAT_GCD_LANES];
+  int shift[RAT_GCD_LANES];
+  uint64_t active = 0;
+  for(int l = 0; l < RAT_GCD_LANES; l++) {
+    // A zero operand gives the other one; start that lane as finished.
+    bool zero = a[l] == 0 || b[l] == 0;
+    x[l] = zero ? a[l] | b[l] : a[l] >> __builtin_ctzll(a[l]);
+    y[l] = zero ? 0 : b[l];
+    shift[l] = zero ? 0 : __builtin_ctzll(a[l] | b[l]);
+    active |= y[l];
+  }
+
+  while(active) {
+    active = 0;
+    for(int l = 0; l < RAT_GCD_LANES; l++) {
+      // ctz of 0 is undefined; the top bit makes it shift a finished lane's 0.
+      uint64_t v = y[l] >> __builtin_ctzll(y[l] | (1ull << 63));
+      uint64_t m = x[l] < v ? x[l] : v;
+      uint64_t diff = x[l] > v ? x[l] - v : v - x[l];
+      x[l] = v ? m : x[l];
+      y[l] = v ? diff : 0;
+      active |= y[l];
+    }
+  }
+
+  for(int l = 0; l < RAT_GCD_LANES; l++) {
+    g[l] = x[l] << shift[l];
+  }
+}
+
+/**
+ * Reduce n/d to lowest terms with a positive divisor.
+ */
+static inline void rat_vec_normalize_one(rat_num_t *n, rat_num_t *d) {
+  bool neg = (*n < 0) != (*d < 0);
+  rat_unum_t un = *n < 0 ? -(rat_unum_t)*n : (rat_unum_t)*n;
+  rat_unum_t ud = *d < 0 ? -(rat_unum_t)*d : (rat_unum_t)*d;
+
+  // Both magnitudes fit in 64 bits; written as two shifts so it is valid when
+  // rat_unum_t itself is 64 bits.
+  if((((un | ud) >> 63) >> 1) == 0) {
+    uint64_t g = rat_gcd64((uint64_t)un, (uint64_t)ud);
+    if(g > 1) {
+      un = (uint64_t)un / g;
+      ud = (uint64_t)ud / g;
+    }
+  } else {
+    rat_num_t g = rat_gcd(*n, *d);
+    rat_unum_t ug = g < 0 ? -(rat_unum_t)g : (rat_unum_t)g;
+    un /= ug;
+    ud /= ug;
+  }
+
+  *n = neg ? -(rat_num_t)un : (rat_num_t)un;
+  *d = (rat_num_t)ud;
+}
+
+void rat_vec_init(rat_vec_t *v, size_t count) {
+  v->count = count;
+  v->numerator = malloc(count * sizeof(rat_num_t));
+  v->divisor = malloc(count * sizeof(rat_num_t));
+  if(count && (!v->numerator || !v->divisor))
+    panic("Out of memory");
+
+  for(size_t i = 0; i < count; i++) {
+    v->numerator[i] = 0;
+    v->divisor[i] = 1;
+  }
+}
+
+void rat_vec_free(rat_vec_t *v) {
+  free(v->numerator);
+  free(v->divisor);
+  v->numerator = NULL;
+  v->divisor = NULL;
+  v->count = 0;
+}
+
+void rat_vec_load(rat_vec_t *v, const rational_t *src) {
+  for(size_t i = 0; i < v->count; i++) {
+    v->numerator[i] = src[i].numerator;
+    v->divisor[i] = src[i].divisor;
+  }
+}
+
+void rat_vec_store(const rat_vec_t *v, rational_t *dst) {
+  for(size_t i = 0; i < v->count; i++) {
+    dst[i].numerator = v->numerator[i];
+    dst[i].divisor = v->divisor[i];
+  }
+}
+
+void rat_vec_get(const rat_vec_t *v, size_t i, rational_t *r) {
+  r->numerator = v->numerator[i];
+  r->divisor = v->divisor[i];
+}
+
+void rat_vec_set(rat_vec_t *v, size_t i, const rational_t *r) {
+  v->numerator[i] = r->numerator;
+  v->divisor[i] = r->divisor;
+}
+
+void rat_vec_normalize(rat_vec_t *v) {
+  rat_num_t *restrict n = v->numerator;
+  rat_num_t *restrict d = v->divisor;
+  size_t i = 0;
+  for(; i + RAT_GCD_LANES <= v->count; i += RAT_GCD_LANES) {
+    uint64_t un[RAT_GCD_LANES], ud[RAT_GCD_LANES], g[RAT_GCD_LANES];
+    rat_unum_t wide = 0;
+    for(int l = 0; l < RAT_GCD_LANES; l++) {
+      rat_num_t x = n[i + l];
+      rat_num_t y = d[i + l];
+      rat_unum_t ux = x < 0 ? -(rat_unum_t)x : (rat_unum_t)x;
+      rat_unum_t uy = y < 0 ? -(rat_unum_t)y : (rat_unum_t)y;
+      wide |= ((ux | uy) >> 63) >> 1;
+      un[l] = (uint64_t)ux;
+      ud[l] = (uint64_t)uy;
+    }
+
+    if(wide) {
+      for(int l = 0; l < RAT_GCD_LANES; l++) {
+        rat_vec_normalize_one(&n[i + l], &d[i + l]);
+      }
+      continue;
+    }
+
+    rat_gcd64_batch(g, un, ud);
+    for(int l = 0; l < RAT_GCD_LANES; l++) {
+      bool neg = (n[i + l] < 0) != (d[i + l] < 0);
+      if(g[l] > 1) {
+        un[l] /= g[l];
+        ud[l] /= g[l];
+      }
+      n[i + l] = neg ? -(rat_num_t)un[l] : (rat_num_t)un[l];
+      d[i + l] = (rat_num_t)ud[l];
+    }
+  }
+
+  for(; i < v->count; i++) {
+    rat_vec_normalize_one(&n[i], &d[i]);
+  }
+}
+
+void rat_vec_add_fast(rat_vec_t *dst, const rat_vec_t *inc) {
+  assert(dst->count == inc->count);
+  rat_num_t *restrict dn = dst->numerator;
+  rat_num_t *restrict dd = dst->divisor;
+  const rat_num_t *restrict in = inc->numerator;
+  const rat_num_t *restrict id = inc->divisor;
+
+  for(size_t base = 0; base < dst->count; base += RAT_VEC_BLOCK) {
+    size_t end = MIN(base + RAT_VEC_BLOCK, dst->count);
+    if(rat_vec_block_small(dst, inc, base, end)) {
+      for(size_t i = base; i < end; i++) {
+        if(dd[i] == id[i]) {
+          dn[i] += in[i];
+        } else {
+          dn[i] = dn[i] * id[i] + in[i] * dd[i];
+          dd[i] = dd[i] * id[i];
+        }
+      }
+    } else {
+      for(size_t i = base; i < end; i++) {
+        rational_t r = { dn[i], dd[i] };
+        rational_t f = { in[i], id[i] };
+        rat_add_fast(&r, &f);
+        dn[i] = r.numerator;
+        dd[i] = r.divisor;
+      }
+    }
+  }
+}
+
+void rat_vec_add(rat_vec_t *dst, const rat_vec_t *inc) {
+  rat_vec_add_fast(dst, inc);
+  rat_vec_normalize(dst);
+}
+
+void rat_vec_sub_fast(rat_vec_t *dst, const rat_vec_t *inc) {
+  assert(dst->count == inc->count);
+  rat_num_t *restrict dn = dst->numerator;
+  rat_num_t *restrict dd = dst->divisor;
+  const rat_num_t *restrict in = inc->numerator;
+  const rat_num_t *restrict id = inc->divisor;
+
+  for(size_t base = 0; base < dst->count; base += RAT_VEC_BLOCK) {
+    size_t end = MIN(base + RAT_VEC_BLOCK, dst->count);
+    if(rat_vec_block_small(dst, inc, base, end)) {
+      for(size_t i = base; i < end; i++) {
+        if(dd[i] == id[i]) {
+          dn[i] -= in[i];
+        } else {
+          dn[i] = dn[i] * id[i] - in[i] * dd[i];
+          dd[i] = dd[i] * id[i];
+        }
+      }
+    } else {
+      for(size_t i = base; i < end; i++) {
+        rat_num_t g = rat_gcd(dd[i], id[i]);
+        rat_num_t dst_fac = id[i] / g;
+        rat_num_t inc_fac = dd[i] / g;
+        dn[i] = chk_sub(chk_mul(dn[i], dst_fac), chk_mul(in[i], inc_fac));
+        dd[i] = chk_mul(dd[i], dst_fac);
+      }
+    }
+  }
+}
+
+void rat_vec_sub(rat_vec_t *dst, const rat_vec_t *inc) {
+  rat_vec_sub_fast(dst, inc);
+  rat_vec_normalize(dst);
+}
+
+void rat_vec_mul_fast(rat_vec_t *d, const rat_vec_t *f) {
+  assert(d->count == f->count);
+  rat_num_t *restrict dn = d->numerator;
+  rat_num_t *restrict dd = d->divisor;
+  const rat_num_t *restrict fn = f->numerator;
+  const rat_num_t *restrict fd = f->divisor;
+
+  for(size_t base = 0; base < d->count; base += RAT_VEC_BLOCK) {
+    size_t end = MIN(base + RAT_VEC_BLOCK, d->count);
+    if(rat_vec_block_small(d, f, base, end)) {
+      for(size_t i = base; i < end; i++) {
+        dn[i] *= fn[i];
+        dd[i] *= fd[i];
+      }
+    } else {
+      for(size_t i = base; i < end; i++) {
+        dn[i] = chk_mul(dn[i], fn[i]);
+        dd[i] = chk_mul(dd[i], fd[i]);
+      }
+    }
+  }
+}
+
+void rat_vec_mul(rat_vec_t *d, const rat_vec_t *f) {
+  rat_vec_mul_fast(d, f);
+  rat_vec_normalize(d);
+}
+
+void rat_vec_div_fast(rat_vec_t *d, const rat_vec_t *f) {
+  assert(d->count == f->count);
+  rat_num_t *restrict dn = d->numerator;
+  rat_num_t *restrict dd = d->divisor;
+  const rat_num_t *restrict fn = f->numerator;
+  const rat_num_t *restrict fd = f->divisor;
+
+  for(size_t base = 0; base < d->count; base += RAT_VEC_BLOCK) {
+    size_t end = MIN(base + RAT_VEC_BLOCK, d->count);
+    if(rat_vec_block_small(d, f, base, end)) {
+      for(size_t i = base; i < end; i++) {
+        dn[i] *= fd[i];
+        dd[i] *= fn[i];
+      }
+    } else {
+      for(size_t i = base; i < end; i++) {
+        dn[i] = chk_mul(dn[i], fd[i]);
+        dd[i] = chk_mul(dd[i], fn[i]);
+      }
+    }
+  }
+}
+
+void rat_vec_div(rat_vec_t *d, const rat_vec_t *f) {
+  rat_vec_div_fast(d, f);
+  rat_vec_normalize(d);
+}
+
+void rat_vec_scale(rat_vec_t *v, const rational_t *f) {
+  rat_num_t *restrict n = v->numerator;
+  rat_num_t *restrict d = v->divisor;
+  rat_num_t fn = f->numerator;
+  rat_num_t fd = f->divisor;
+  bool f_small = rat_small(fn) && rat_small(fd);
+
+  for(size_t base = 0; base < v->count; base += RAT_VEC_BLOCK) {
+    size_t end = MIN(base + RAT_VEC_BLOCK, v->count);
+    if(f_small && rat_vec_small(n, base, end) && rat_vec_small(d, base, end)) {
+      for(size_t i = base; i < end; i++) {
+        n[i] *= fn;
+        d[i] *= fd;
+      }
+    } else {
+      for(size_t i = base; i < end; i++) {
+        n[i] = chk_mul(n[i], fn);
+        d[i] = chk_mul(d[i], fd);
+      }
+    }
+  }
+
+  rat_vec_normalize(v);
+}
+
+void rat_vec_scale_s(rat_vec_t *v, int64_t s) {
+  rational_t f = { s, 1 };
+  rat_vec_scale(v, &f);
+}
+
+size_t rat_vec_cmp(const rat_vec_t *v, const rational_t *threshold, signed char *result) {
+  const rat_num_t *restrict n = v->numerator;
+  const rat_num_t *restrict d = v->divisor;
+  rat_num_t tn = threshold->numerator;
+  rat_num_t td = threshold->divisor;
+  bool t_small = rat_small(tn) && rat_small(td);
+  size_t greater = 0;
+
+  for(size_t base = 0; base < v->count; base += RAT_VEC_BLOCK) {
+    size_t end = MIN(base + RAT_VEC_BLOCK, v->count);
+    if(t_small && rat_vec_small(n, base, end) && rat_vec_small(d, base, end)) {
+      for(size_t i = base; i < end; i++) {
+        rat_num_t diff = n[i] * td - tn * d[i];
+        result[i] = (diff > 0) - (diff < 0);
+        greater += diff > 0;
+      }
+    } else {
+      for(size_t i = base; i < end; i++) {
+        rational_t r = { n[i], d[i] };
+        result[i] = rat_cmp(&r, threshold);
+        greater += result[i] > 0;
+      }
+    }
+  }
+
+  return greater;
+}
+
+/**
+ * Add n/d to a running total, normalizing only when it leaves the small range.
+ */
+static inline void rat_vec_accumulate(rational_t *acc, rat_num_t n, rat_num_t d) {
+  if(acc->divisor == d) {
+    acc->numerator = chk_add(acc->numerator, n);
+  } else if(rat_small(acc->numerator) && rat_small(acc->divisor) && rat_small(n) && rat_small(d)) {
+    acc->numerator = acc->numerator * d + n * acc->divisor;
+    acc->divisor *= d;
+  } else {
+    rational_t inc = { n, d };
+    rat_add_fast(acc, &inc);
+  }
+
+  if(!rat_small(acc->numerator) || !rat_small(acc->divisor))
+    rat_vec_normalize_one(&acc->numerator, &acc->divisor);
+}
+
+void rat_vec_sum(const rat_vec_t *v, rational_t *result) {
+  result->numerator = 0;
+  result->divisor = 1;
+  for(size_t i = 0; i < v->count; i++) {
+    rat_vec_accumulate(result, v->numerator[i], v->divisor[i]);
+  }
+  rat_vec_normalize_one(&result->numerator, &result->divisor);
+}
+
+void rat_vec_prod(const rat_vec_t *v, rational_t *result) {
+  result->numerator = 1;
+  result->divisor = 1;
+  for(size_t i = 0; i < v->count; i++) {
+    rat_num_t n = v->numerator[i];
+    rat_num_t d = v->divisor[i];
+    if(rat_small(result->numerator) && rat_small(result->divisor) && rat_small(n) && rat_small(d)) {
+      result->numerator *= n;
+      result->divisor *= d;
+    } else {
+      rational_t f = { n, d };
+      rat_mul(result, &f);
+    }
+
+    if(!rat_small(result->numerator) || !rat_small(result->divisor))
+      rat_vec_normalize_one(&result->numerator, &result->divisor);
+  }
+  rat_vec_normalize_one(&result->numerator, &result->divisor);
+}
+
+void rat_vec_dot(const rat_vec_t *a, const rat_vec_t *b, rational_t *result) {
+  assert(a->count == b->count);
+  result->numerator = 0;
+  result->divisor = 1;
+  for(size_t i = 0; i < a->count; i++) {
+    rat_num_t n, d;
+    if(rat_small(a->numerator[i]) && rat_small(a->divisor[i]) &&
+       rat_small(b->numerator[i]) && rat_small(b->divisor[i])) {
+      n = a->numerator[i] * b->numerator[i];
+      d = a->divisor[i] * b->divisor[i];
+    } else {
+      n = chk_mul(a->numerator[i], b->numerator[i]);
+      d = chk_mul(a->divisor[i], b->divisor[i]);
+    }
+
+    if(!rat_small(n) || !rat_small(d))
+      rat_vec_normalize_one(&n, &d);
+
+    rat_vec_accumulate(result, n, d);
+  }
+  rat_vec_normalize_one(&result->numerator, &result->divisor);
+}
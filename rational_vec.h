@@ -0,0 +1,83 @@
+#ifndef RATIONAL_VEC_H
+#define RATIONAL_VEC_H
+
+#include "rational.h"
+
+#include <stddef.h>
+
+/**
+ * \brief Vector of rationals, stored as separate numerator and divisor arrays.
+ *
+ * All kernels operate element-wise on the whole vector; the operands of the
+ * binary kernels must have the same count (asserted). The plain versions
+ * leave every element normalized, with a positive divisor. The _fast versions
+ * skip normalization so a chain of operations can be normalized once at the
+ * end with rat_vec_normalize().
+ *
+ * Blocks of elements whose components are all small enough are processed
+ * without overflow checks and without calls into rational.c; other blocks fall
+ * back to the overflow-checked scalar operations.
+ */
+typedef struct rat_vec {
+  rat_num_t *numerator;
+  rat_num_t *divisor;
+  size_t count;
+} rat_vec_t;
+
+/**
+ * Allocate a vector of count elements, all set to 0/1.
+ */
+void rat_vec_init(rat_vec_t *v, size_t count);
+void rat_vec_free(rat_vec_t *v);
+
+void rat_vec_load(rat_vec_t *v, const rational_t *src);
+void rat_vec_store(const rat_vec_t *v, rational_t *dst);
+void rat_vec_get(const rat_vec_t *v, size_t i, rational_t *r);
+void rat_vec_set(rat_vec_t *v, size_t i, const rational_t *r);
+
+void rat_vec_normalize(rat_vec_t *v);
+
+void rat_vec_add(rat_vec_t *dst, const rat_vec_t *inc);
+void rat_vec_add_fast(rat_vec_t *dst, const rat_vec_t *inc);
+void rat_vec_sub(rat_vec_t *dst, const rat_vec_t *inc);
+void rat_vec_sub_fast(rat_vec_t *dst, const rat_vec_t *inc);
+void rat_vec_mul(rat_vec_t *d, const rat_vec_t *f);
+void rat_vec_mul_fast(rat_vec_t *d, const rat_vec_t *f);
+void rat_vec_div(rat_vec_t *d, const rat_vec_t *f);
+void rat_vec_div_fast(rat_vec_t *d, const rat_vec_t *f);
+
+/**
+ * Multiply every element by f.
+ */
+void rat_vec_scale(rat_vec_t *v, const rational_t *f);
+
+/**
+ * Multiply every element by s.
+ */
+void rat_vec_scale_s(rat_vec_t *v, int64_t s);
+
+/**
+ * \brief Compare every element against threshold.
+ *
+ * result[i] is set to +1, 0 or -1 like rat_cmp(). Divisors must be positive.
+ *
+ * \return The number of elements greater than threshold.
+ */
+size_t rat_vec_cmp(const rat_vec_t *v, const rational_t *threshold, signed char *result);
+
+/**
+ * Sum of all elements, normalized.
+ */
+void rat_vec_sum(const rat_vec_t *v, rational_t *result);
+
+/**
+ * Product of all elements, normalized.
+ */
+void rat_vec_prod(const rat_vec_t *v, rational_t *result);
+
+/**
+ * Sum of the element-wise products of a and b, normalized.
+ */
+void rat_vec_dot(const rat_vec_t *a, const rat_vec_t *b, rational_t *result);
+
+#endif
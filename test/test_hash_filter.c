@@ -0,0 +1,193 @@
+#include "hash.h"
+#include "minunit.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Bloom and cuckoo filters over uint32_t keys. Members use keys 0 .. n - 1,
+ * non-members keys from 1 << 31 up. ctest runs these once with the dispatched
+ * kernels and once with PGOLIB_CPU=baseline.
+ */
+
+#define FILTER_KEYS 20000
+#define MISS_BASE 0x80000000u
+
+static uint32_t *make_keys(uint32_t base, size_t count) {
+  uint32_t *keys = malloc(count * sizeof *keys);
+  mu_assert(keys != NULL);
+  for(size_t i = 0; i < count; i++)
+    keys[i] = base + i;
+  return keys;
+}
+
+static void test_bloom_no_false_negatives() {
+  hash_bloom_t f;
+  uint32_t *keys = make_keys(0, FILTER_KEYS);
+  uint32_t *miss = make_keys(MISS_BASE, FILTER_KEYS);
+  bool *result = malloc(FILTER_KEYS * sizeof *result);
+
+  hash_bloom_init(&f, hash_fnv32_u32, FILTER_KEYS, 0.01);
+  // Half one at a time, half batched.
+  for(size_t i = 0; i < FILTER_KEYS / 2; i++)
+    hash_bloom_insert(&f, &keys[i]);
+  hash_bloom_insert_batch(&f, keys + FILTER_KEYS / 2, sizeof *keys, FILTER_KEYS - FILTER_KEYS / 2);
+
+  for(size_t i = 0; i < FILTER_KEYS; i++)
+    mu_assert(hash_bloom_contains(&f, &keys[i]));
+  mu_assert(hash_bloom_contains_batch(&f, keys, sizeof *keys, FILTER_KEYS, result) == FILTER_KEYS);
+  for(size_t i = 0; i < FILTER_KEYS; i++)
+    mu_assert(result[i]);
+
+  // The hash is fixed, so this is deterministic. Allow twice the expected rate.
+  size_t hits = hash_bloom_contains_batch(&f, miss, sizeof *miss, FILTER_KEYS, result);
+  mu_assert(hits <= 2 * f.fpr * FILTER_KEYS);
+  for(size_t i = 0; i < FILTER_KEYS; i++)
+    mu_assert(result[i] == hash_bloom_contains(&f, &miss[i]));
+
+  hash_bloom_free(&f);
+  free(keys);
+  free(miss);
+  free(result);
+}
+
+/**
+ * Fill a cuckoo filter for fpr to capacity and check every key is found, both
+ * ways, and that the fingerprint width is bits.
+ */
+static void check_cuckoo_fill(double fpr, unsigned bits) {
+  hash_cuckoo_t f;
+  uint32_t *keys = make_keys(0, FILTER_KEYS);
+  bool *result = malloc(FILTER_KEYS * sizeof *result);
+
+  hash_cuckoo_init(&f, hash_fnv32_u32, FILTER_KEYS, fpr);
+  mu_assert(f.fp_bits == bits);
+  size_t n = FILTER_KEYS / 2;
+  for(size_t i = 0; i < n; i++)
+    mu_assert(hash_cuckoo_insert(&f, &keys[i]));
+  n += hash_cuckoo_insert_batch(&f, keys + n, sizeof *keys, FILTER_KEYS - n);
+  mu_assert(n == FILTER_KEYS);
+  mu_assert(f.count == n);
+
+  for(size_t i = 0; i < n; i++)
+    mu_assert(hash_cuckoo_contains(&f, &keys[i]));
+  mu_assert(hash_cuckoo_contains_batch(&f, keys, sizeof *keys, n, result) == n);
+
+  hash_cuckoo_free(&f);
+  free(keys);
+  free(result);
+}
+
+static void test_cuckoo_no_false_negatives() {
+  check_cuckoo_fill(0.05, 8);
+  check_cuckoo_fill(0.01, 12);
+  check_cuckoo_fill(0.001, 16);
+}
+
+/**
+ * Remove every other key and put them back. A 12 bit bucket is 6 bytes
+ * loaded and stored as 4 + 2, so a packing error shows up as a lost neighbour.
+ */
+static void test_cuckoo_12bit_packing() {
+  hash_cuckoo_t f;
+  uint32_t *keys = make_keys(0, FILTER_KEYS);
+
+  hash_cuckoo_init(&f, hash_fnv32_u32, FILTER_KEYS, 0.01);
+  mu_assert(f.fp_bits == 12);
+  mu_assert(hash_cuckoo_insert_batch(&f, keys, sizeof *keys, FILTER_KEYS) == FILTER_KEYS);
+
+  for(size_t i = 0; i < FILTER_KEYS; i += 2)
+    mu_assert(hash_cuckoo_remove(&f, &keys[i]));
+  mu_assert(f.count == FILTER_KEYS / 2);
+  for(size_t i = 1; i < FILTER_KEYS; i += 2)
+    mu_assert(hash_cuckoo_contains(&f, &keys[i]));
+
+  for(size_t i = 0; i < FILTER_KEYS; i += 2)
+    mu_assert(hash_cuckoo_insert(&f, &keys[i]));
+  for(size_t i = 0; i < FILTER_KEYS; i++)
+    mu_assert(hash_cuckoo_contains(&f, &keys[i]));
+
+  hash_cuckoo_free(&f);
+  free(keys);
+}
+
+/**
+ * Overfill a small filter until a fingerprint is left without a slot, then
+ * remove the keys one by one. Every key not yet removed must still be found,
+ * whether it sits in a bucket or is the pending victim.
+ */
+static void check_cuckoo_victim(double fpr) {
+  enum { CAPACITY = 64, MAX_KEYS = 4 * CAPACITY };
+  hash_cuckoo_t f;
+  uint32_t *keys = make_keys(0, MAX_KEYS);
+
+  hash_cuckoo_init(&f, hash_fnv32_u32, CAPACITY, fpr);
+  size_t n = 0;
+  while(n < MAX_KEYS && hash_cuckoo_insert(&f, &keys[n]))
+    n++;
+  mu_assert(n < MAX_KEYS);
+  mu_assert(f.victim != 0);
+  mu_assert(f.count == n);
+
+  for(size_t i = 0; i < n; i++) {
+    mu_assert(hash_cuckoo_remove(&f, &keys[i]));
+    for(size_t j = i + 1; j < n; j++)
+      mu_assert(hash_cuckoo_contains(&f, &keys[j]));
+  }
+  mu_assert(f.count == 0);
+  mu_assert(f.victim == 0);
+  // Empty again, so inserts work.
+  mu_assert(hash_cuckoo_insert(&f, &keys[0]));
+  mu_assert(hash_cuckoo_contains(&f, &keys[0]));
+
+  hash_cuckoo_free(&f);
+  free(keys);
+}
+
+static void test_cuckoo_remove_victim() {
+  check_cuckoo_victim(0.05);
+  check_cuckoo_victim(0.01);
+  check_cuckoo_victim(0.001);
+}
+
+/*
+ * With 2^20 keys, the hash floor is 2^-12. A rate above twice the floor is
+ * met; one below it gets about twice the floor, not a huge filter.
+ */
+
+#define CLAMP_KEYS (1 << 20)
+#define CLAMP_FLOOR (CLAMP_KEYS / 4294967296.0)
+
+static void test_filter_fpr_clamp() {
+  static const double rates[] = { 0.01, 3 * CLAMP_FLOOR, 1.5 * CLAMP_FLOOR, CLAMP_FLOOR, 1e-9 };
+
+  for(size_t r = 0; r < sizeof rates / sizeof rates[0]; r++) {
+    double fpr = rates[r];
+    // What the filter should be sized for: max(fpr, 2 * floor).
+    double expected = fpr > 2 * CLAMP_FLOOR ? fpr : 2 * CLAMP_FLOOR;
+
+    hash_bloom_t b;
+    hash_bloom_init(&b, hash_fnv32_u32, CLAMP_KEYS, fpr);
+    mu_assert(b.fpr > CLAMP_FLOOR);
+    mu_assert(b.fpr <= expected * (1 + 1e-9));
+    // No more than 64 bits per key even for 1e-9.
+    mu_assert(b.groups * b.k * 32 <= 64.0 * CLAMP_KEYS);
+    hash_bloom_free(&b);
+
+    hash_cuckoo_t c;
+    hash_cuckoo_init(&c, hash_fnv32_u32, CLAMP_KEYS, fpr);
+    mu_assert(c.fpr > CLAMP_FLOOR);
+    mu_assert(c.fpr <= expected * (1 + 1e-9));
+    hash_cuckoo_free(&c);
+  }
+}
+
+static void test_hash_filter() {
+  mu_run_test(test_bloom_no_false_negatives);
+  mu_run_test(test_cuckoo_no_false_negatives);
+  mu_run_test(test_cuckoo_12bit_packing);
+  mu_run_test(test_cuckoo_remove_victim);
+  mu_run_test(test_filter_fpr_clamp);
+}
+
+mu_declare_suite(test_hash_filter);
@@ -0,0 +1,174 @@
+#include "lockfree.h"
+#include "minunit.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+typedef struct test_node {
+  list_node_t list;
+  int producer;
+  int seq;
+} test_node_t;
+
+static int seq_of(list_node_t *node) {
+  test_node_t *n = container_of(node, test_node_t, list);
+  return n->seq;
+}
+
+static void test_stack_empty() {
+  lf_stack_t s;
+  test_node_t n = { .seq = 1 };
+  lf_stack_init(&s);
+  mu_assert(lf_stack_pop(&s) == NULL);
+  mu_assert(lf_stack_pop_all(&s) == NULL);
+
+  lf_stack_push(&s, &n.list);
+  mu_assert(lf_stack_pop(&s) == &n.list);
+  mu_assert(lf_stack_pop(&s) == NULL);
+}
+
+static void test_stack_pop_after_pop_all() {
+  lf_stack_t s;
+  test_node_t n[4];
+  lf_stack_init(&s);
+  for(int i = 0; i < 3; i++) {
+    n[i].seq = i;
+    lf_stack_push(&s, &n[i].list);
+  }
+
+  int expected = 2;
+  for(list_node_t h = lf_stack_pop_all(&s); h; h = LIST_next_direct(h))
+    mu_assert(seq_of(h) == expected--);
+  mu_assert(expected == -1);
+  mu_assert(lf_stack_pop(&s) == NULL);
+  mu_assert(lf_stack_pop_all(&s) == NULL);
+
+  n[3].seq = 3;
+  lf_stack_push(&s, &n[3].list);
+  mu_assert(lf_stack_pop(&s) == &n[3].list);
+  mu_assert(lf_stack_pop(&s) == NULL);
+}
+
+static void test_queue_empty() {
+  lf_queue_t q;
+  test_node_t n = { .seq = 1 };
+  lf_queue_init(&q);
+  mu_assert(lf_queue_pop(&q) == NULL);
+  mu_assert(lf_queue_pop_all(&q) == NULL);
+
+  lf_queue_push(&q, &n.list);
+  mu_assert(lf_queue_pop(&q) == &n.list);
+  mu_assert(lf_queue_pop(&q) == NULL);
+}
+
+static void test_queue_pop_after_pop_all() {
+  lf_queue_t q;
+  test_node_t n[6];
+  lf_queue_init(&q);
+  for(int i = 0; i < 6; i++)
+    n[i].seq = i;
+
+  // Node 0 goes to the consumer's private list, 1 and 2 stay shared.
+  for(int i = 0; i < 3; i++)
+    lf_queue_push(&q, &n[i].list);
+  mu_assert(lf_queue_pop(&q) == &n[0].list);
+  lf_queue_push(&q, &n[3].list);
+  lf_queue_push(&q, &n[4].list);
+
+  int expected = 1;
+  for(list_node_t h = lf_queue_pop_all(&q); h; h = LIST_next_direct(h))
+    mu_assert(seq_of(h) == expected++);
+  mu_assert(expected == 5);
+  mu_assert(lf_queue_pop(&q) == NULL);
+  mu_assert(lf_queue_pop_all(&q) == NULL);
+
+  lf_queue_push(&q, &n[5].list);
+  mu_assert(lf_queue_pop(&q) == &n[5].list);
+  mu_assert(lf_queue_pop(&q) == NULL);
+}
+
+/*
+ * QUEUE_PRODUCERS threads push QUEUE_NODES nodes each, singly and in batches
+ * of three, while this thread pops them alternately one at a time and all at
+ * once. Every producer's nodes must come out exactly once, in push order.
+ */
+
+#define QUEUE_PRODUCERS 4
+#define QUEUE_NODES 100000
+
+static lf_queue_t mpsc;
+static test_node_t *mpsc_nodes;
+
+static void *mpsc_producer(void *arg) {
+  int id = (int)(intptr_t)arg;
+  test_node_t *n = mpsc_nodes + id * QUEUE_NODES;
+  for(int i = 0; i < QUEUE_NODES; ) {
+    if(i % 7 == 0 && i + 3 <= QUEUE_NODES) {
+      list_node_t batch = NULL;
+      for(int k = 0; k < 3; k++) {
+        n[i + k].producer = id;
+        n[i + k].seq = i + k;
+        LIST_insert(&batch, &n[i + k].list);
+      }
+      lf_queue_push_batch(&mpsc, batch, &n[i].list);
+      i += 3;
+    } else {
+      n[i].producer = id;
+      n[i].seq = i;
+      lf_queue_push(&mpsc, &n[i].list);
+      i++;
+    }
+  }
+  return NULL;
+}
+
+static void mpsc_take(list_node_t *node, int *next) {
+  test_node_t *n = container_of(node, test_node_t, list);
+  mu_assert(n->producer >= 0 && n->producer < QUEUE_PRODUCERS);
+  mu_assert(n->seq == next[n->producer]);
+  next[n->producer]++;
+}
+
+static void test_queue_mpsc_fifo() {
+  pthread_t threads[QUEUE_PRODUCERS];
+  int next[QUEUE_PRODUCERS] = { 0 };
+  long taken = 0;
+
+  mpsc_nodes = calloc(QUEUE_PRODUCERS * QUEUE_NODES, sizeof *mpsc_nodes);
+  mu_assert(mpsc_nodes != NULL);
+  lf_queue_init(&mpsc);
+  for(int i = 0; i < QUEUE_PRODUCERS; i++)
+    mu_assert(pthread_create(&threads[i], NULL, mpsc_producer, (void *)(intptr_t)i) == 0);
+
+  for(long round = 0; taken < (long)QUEUE_PRODUCERS * QUEUE_NODES; round++) {
+    if(round & 1) {
+      list_node_t *node = lf_queue_pop(&mpsc);
+      if(node) {
+        mpsc_take(node, next);
+        taken++;
+      }
+    } else {
+      for(list_node_t h = lf_queue_pop_all(&mpsc); h; h = LIST_next_direct(h)) {
+        mpsc_take(h, next);
+        taken++;
+      }
+    }
+  }
+
+  for(int i = 0; i < QUEUE_PRODUCERS; i++) {
+    pthread_join(threads[i], NULL);
+    mu_assert(next[i] == QUEUE_NODES);
+  }
+  mu_assert(lf_queue_pop(&mpsc) == NULL);
+  free(mpsc_nodes);
+}
+
+static void test_lockfree() {
+  mu_run_test(test_stack_empty);
+  mu_run_test(test_stack_pop_after_pop_all);
+  mu_run_test(test_queue_empty);
+  mu_run_test(test_queue_pop_after_pop_all);
+  mu_run_test(test_queue_mpsc_fifo);
+}
+
+mu_declare_suite(test_lockfree);
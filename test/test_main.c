@@ -0,0 +1,23 @@
+#include "minunit.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * pgolib_test: runs every suite declared in test_*.c. Exits with 1 if any
+ * test failed. See minunit.h for MU_JOBS, MU_TIMEOUT and MU_REPORT.
+ */
+
+void panic(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+  abort();
+}
+
+int main(void) {
+  return mu_run_all_suites() ? 1 : 0;
+}
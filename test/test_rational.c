@@ -0,0 +1,199 @@
+#include "rational.h"
+#include "rational_vec.h"
+#include "rational_mat.h"
+#include "params.h"
+#include "minunit.h"
+
+#include <string.h>
+
+#define RAT_MAX ((rat_num_t)(((rat_unum_t)1 << (RAT_BITS - 1)) - 1))
+#define RAT_MIN (-RAT_MAX - 1)
+
+#ifdef __LP64__
+#define RAT_MAX_STR "170141183460469231731687303715884105727"
+#define RAT_MIN_STR "-170141183460469231731687303715884105728"
+#define RAT_OVER_STR "170141183460469231731687303715884105728"
+#define RAT_UNDER_STR "-170141183460469231731687303715884105729"
+#else
+#define RAT_MAX_STR "9223372036854775807"
+#define RAT_MIN_STR "-9223372036854775808"
+#define RAT_OVER_STR "9223372036854775808"
+#define RAT_UNDER_STR "-9223372036854775809"
+#endif
+
+static void check_num(rat_num_t a, const char *expected) {
+  char buf[RAT_NUM_STR_SIZE];
+  size_t len = rat_num_fmt(buf, a);
+  mu_assert_eq_str(buf, expected);
+  mu_assert(len == strlen(expected));
+  mu_assert_eq_str(rat_str(a), expected);
+
+  rat_num_t parsed;
+  const char *end = rat_num_parse(buf, &parsed);
+  mu_assert(end == buf + len);
+  mu_assert(parsed == a);
+}
+
+static void test_num_fmt_parse() {
+  check_num(0, "0");
+  check_num(1, "1");
+  check_num(-1, "-1");
+  check_num(RAT_MAX, RAT_MAX_STR);
+  check_num(RAT_MIN, RAT_MIN_STR);
+}
+
+// rat_num_fmt() and rat_num_parse() work in chunks of 19 digits.
+static void test_num_chunk_boundary() {
+#ifdef __LP64__
+  const rat_num_t e19 = 10000000000000000000ULL;
+  check_num(e19 - 1, "9999999999999999999");
+  check_num(e19, "10000000000000000000");
+  check_num(e19 + 1, "10000000000000000001");
+  check_num(-e19, "-10000000000000000000");
+  check_num(e19 * e19, "100000000000000000000000000000000000000");
+  check_num(e19 * e19 - 1, "99999999999999999999999999999999999999");
+#else
+  check_num(999999999999999999LL, "999999999999999999");
+  check_num(1000000000000000000LL, "1000000000000000000");
+#endif
+}
+
+static void test_num_parse_rejects() {
+  rat_num_t a = 42;
+  mu_assert(rat_num_parse(RAT_OVER_STR, &a) == NULL);
+  mu_assert(rat_num_parse(RAT_UNDER_STR, &a) == NULL);
+  mu_assert(rat_num_parse("99999999999999999999999999999999999999999999", &a) == NULL);
+  mu_assert(rat_num_parse("", &a) == NULL);
+  mu_assert(rat_num_parse("-", &a) == NULL);
+  mu_assert(rat_num_parse("x1", &a) == NULL);
+
+  const char *s = "+12/";
+  mu_assert(rat_num_parse(s, &a) == s + 3);
+  mu_assert(a == 12);
+}
+
+static void test_parse_divisor() {
+  rational_t r;
+  const char *s = "-3/4x";
+  mu_assert(rat_parse(s, &r) == s + 4);
+  mu_assert(r.numerator == -3 && r.divisor == 4);
+
+  s = "7";
+  mu_assert(rat_parse(s, &r) == s + 1);
+  mu_assert(r.numerator == 7 && r.divisor == 1);
+
+  mu_assert(rat_parse("1/0", &r) == NULL);
+  mu_assert(rat_parse("1/", &r) == NULL);
+}
+
+static void test_array_round_trip() {
+  rational_t a[] = { { 0, 1 }, { -1, 2 }, { RAT_MAX, 3 }, { RAT_MIN, RAT_MAX }, { 5, 1 } };
+  const size_t count = sizeof a / sizeof a[0];
+  char buf[sizeof a / sizeof a[0] * RAT_STR_SIZE + 1];
+  const char seps[] = { ',', ' ', '\n' };
+
+  for(size_t i = 0; i < sizeof seps; i++) {
+    size_t len = rat_fmt_array(buf, a, count, seps[i]);
+    mu_assert(len == strlen(buf));
+
+    rational_t b[sizeof a / sizeof a[0] + 1];
+    const char *end;
+    mu_assert(rat_parse_array(buf, b, count + 1, &end) == count);
+    mu_assert(end == buf + len);
+    for(size_t j = 0; j < count; j++) {
+      mu_assert(b[j].numerator == a[j].numerator && b[j].divisor == a[j].divisor);
+    }
+  }
+
+  buf[0] = 'x';
+  mu_assert(rat_fmt_array(buf, a, 0, ',') == 0);
+  mu_assert_eq_str(buf, "");
+}
+
+static void test_parse_array_stops() {
+  rational_t r[4];
+  const char *s = "1/2, 3 ;4";
+  const char *end;
+  mu_assert(rat_parse_array(s, r, 4, &end) == 2);
+  mu_assert(*end == ';');
+  mu_assert(rat_parse_array("1/2 3/0", r, 4, NULL) == 1);
+}
+
+static void test_rational_fmt() {
+  mu_run_test(test_num_fmt_parse);
+  mu_run_test(test_num_chunk_boundary);
+  mu_run_test(test_num_parse_rejects);
+  mu_run_test(test_parse_divisor);
+  mu_run_test(test_array_round_trip);
+  mu_run_test(test_parse_array_stops);
+}
+
+mu_declare_suite(test_rational_fmt);
+
+/*
+ * Sign convention: every normalized result has a positive divisor and the sign
+ * on the numerator, whether it comes from the scalar, vector or matrix code.
+ */
+
+static const rational_t sign_in[] = {
+  { 6, -4 }, { -6, -4 }, { -6, 4 }, { 6, 4 }, { 0, -5 }, { 3, -1 },
+};
+static const rational_t sign_out[] = {
+  { -3, 2 }, { 3, 2 }, { -3, 2 }, { 3, 2 }, { 0, 1 }, { -3, 1 },
+};
+#define SIGN_COUNT (sizeof sign_in / sizeof sign_in[0])
+
+static void test_normalize_sign() {
+  for(size_t i = 0; i < SIGN_COUNT; i++) {
+    rational_t r = sign_in[i];
+    rat_normalize(&r);
+    mu_assert(r.numerator == sign_out[i].numerator && r.divisor == sign_out[i].divisor);
+  }
+
+  rational_t r = { 1, 2 };
+  rational_t f = { -1, 3 };
+  rat_div(&r, &f);
+  mu_assert(r.numerator == -3 && r.divisor == 2);
+}
+
+static void test_vec_normalize_sign() {
+  rational_t r[SIGN_COUNT];
+  rat_vec_t v;
+  rat_vec_init(&v, SIGN_COUNT);
+  rat_vec_load(&v, sign_in);
+  rat_vec_normalize(&v);
+  rat_vec_store(&v, r);
+  rat_vec_free(&v);
+  for(size_t i = 0; i < SIGN_COUNT; i++) {
+    mu_assert(r[i].numerator == sign_out[i].numerator && r[i].divisor == sign_out[i].divisor);
+  }
+}
+
+static void test_mat_sign() {
+  rat_mat_t a, inv;
+  rat_mat_init(&a, 1, 1);
+  rat_mat_init(&inv, 1, 1);
+  for(size_t i = 0; i < SIGN_COUNT; i++) {
+    if(sign_in[i].numerator == 0)
+      continue;
+    RAT_MAT_at(&a, 0, 0) = sign_in[i];
+    rational_t det;
+    rat_mat_det(&a, &det);
+    mu_assert(det.numerator == sign_out[i].numerator && det.divisor == sign_out[i].divisor);
+
+    mu_assert(rat_mat_inverse(&a, &inv));
+    rational_t x = RAT_MAT_at(&inv, 0, 0);
+    mu_assert(x.divisor > 0);
+    mu_assert(x.numerator * sign_out[i].numerator == x.divisor * sign_out[i].divisor);
+  }
+  rat_mat_free(&a);
+  rat_mat_free(&inv);
+}
+
+static void test_rational_sign() {
+  mu_run_test(test_normalize_sign);
+  mu_run_test(test_vec_normalize_sign);
+  mu_run_test(test_mat_sign);
+}
+
+mu_declare_suite(test_rational_sign);